@@ -5,13 +5,20 @@
 #include <stdlib.h> // Standard library functions
 #include <gui/elements.h> // to access button drawing functions
 #include <stdio.h>
+#include <stdarg.h>
 #include <string.h>
 #include <storage/storage.h>
+#include <toolbox/saved_struct.h> // preferences file
 #include <furi_hal_rtc.h> // for getting the current date
+#include <notification/notification_messages.h> // alerts
 #include <math.h> // for sin, cos, tan, acos
+#include "suntimes.h" // sun engine
+#include "tzrules.h" // daylight saving time rules
+#include "cities.h" // built-in city table
+#include "astro.h" // preferences
 
 #define TAG "Astro" // Tag for logging purposes
-#define MAX_CITIES 200
+#define MAX_CITIES 200 // built-in plus SD file
 #define MAX_LINE_LENGTH 256
 
 extern const Icon I_splash, I_icon_10x10, I_capital_10x10, I_Sunset_10x10, I_Sunrise_10x10, I_HourGlas_10x10;
@@ -19,14 +26,62 @@ extern const Icon I_ButtonDown_7x4, I_ButtonUp_7x4;
 
 typedef enum {
     ScreenSplash,
-	ScreenCities
+	ScreenCities,
+	ScreenViews,   // menu of the views below, opened with OK on the cities screen
+	ScreenRanking,
+	ScreenMoon,
+	ScreenPosition,
+	ScreenLight,
+	ScreenAlerts,
+	ScreenExport
 } AppScreen;
 
+// Entries of the views menu
+typedef enum {
+    ViewRanking,
+    ViewMoon,
+    ViewPosition,
+    ViewLight,
+    ViewAlerts,
+    ViewExport,
+    ViewCount
+} AppView;
+
+static const char* view_labels[ViewCount] = {"Compare cities", "Moon", "Sun position", "Golden & blue hour", "Alerts", "Export year"};
+
+static const char* moon_phase_labels[MoonPhaseCount] = {
+    "New moon", "Waxing crescent", "First quarter", "Waxing gibbous",
+    "Full moon", "Waning gibbous", "Last quarter", "Waning crescent"};
+
 typedef enum {
     MenuCountry,
-	MenuCity
+	MenuCity,
+	MenuDate
 } AppMenu;
 
+// Step sizes for the date navigation, cycled with OK
+typedef enum {
+    DateStepDay,
+    DateStepWeek,
+    DateStepMonth,
+    DateStepCount
+} DateStep;
+
+static const char* date_step_labels[DateStepCount] = {"Day", "Week", "Month"};
+
+// Events in the message queue: key presses, timer ticks while a live view is
+// shown, and the alert timer
+typedef enum {
+    EventTypeKey,
+    EventTypeTick,
+    EventTypeAlert,
+} EventType;
+
+typedef struct {
+    EventType type;
+    InputEvent input;
+} AppEvent;
+
 struct EuropeanCountry {
     char code[3];     
     char name[32];
@@ -87,33 +142,206 @@ static struct EuropeanCountry european_countries[] = {
 // Number of countries in the array
 const int country_count = sizeof(european_countries) / sizeof(european_countries[0]);
 
-// City structure
-typedef struct {
-    char country_code[3];
-    double utc_shift;
-    char name[32];
-    double longitude;
-    double latitude;
-    int elevation_m;
-    uint8_t is_capital;
-} City;
-
-// Global city storage
-static City cities[MAX_CITIES];
+// Global city storage: the built-in table (cities_builtin.c, read-only), followed
+// by the cities of the optional file on the SD card. Use city_at() for access.
+static City* sd_cities = NULL;
+static char (*sd_city_names)[32] = NULL;
+static int sd_city_count = 0;
 static int city_count = 0;
 static int filtered_city_count = 0;
 static int filtered_city_indices[MAX_CITIES];
 
+// Structure-of-arrays mirror of cities[] for the batch sun engine,
+// rebuilt by build_city_soa() whenever cities[] changes
+static struct {
+    float sin_lat[MAX_CITIES];
+    float cos_lat[MAX_CITIES];
+    float lng_hour[MAX_CITIES];  // longitude in hours, east positive
+    const TzRule* tz_rule[MAX_CITIES];
+    TzYear tz[MAX_CITIES];       // UTC offset rules resolved for tz_year
+    int tz_year;
+} city_soa;
+
+// The alerts and the sun position follow the RTC date, while the cities
+// screen may browse another year. They resolve the rules of their few cities
+// (home and favourites) here, see rtc_city_offset_minutes(), so
+// they do not evict the year cached in city_soa.tz.
+#define RTC_TZ_SLOTS (ALERT_MAX_FAVOURITES + 1)
+static struct {
+    int16_t city[RTC_TZ_SLOTS];  // index for city_at(), -1 if unused
+    TzYear tz[RTC_TZ_SLOTS];
+    int next;                    // slot to reuse for a city not cached yet
+} rtc_tz;
+
+// Ranking of cities by a sun event, see compute_ranking()
+typedef enum {
+    RankSunrise,   // earliest sunrise (in UT) first
+    RankSunset,    // latest sunset first
+    RankDaylength, // longest day first
+    RankModeCount
+} RankMode;
+
+static const char* rank_mode_labels[RankModeCount] = {"First sunrise", "Last sunset", "Longest day"};
+
+#define RANK_TOP_N 20
+
+typedef struct {
+    int16_t city;      // index for city_at()
+    float key;         // ascending sort key
+    float value_hours; // local event time or day length, shown in the list
+} RankEntry;
+
+static RankEntry ranking[RANK_TOP_N];
+static int ranking_count = 0;
+static float rank_rise_ut[MAX_CITIES]; // batch output scratch
+static float rank_set_ut[MAX_CITIES];
+
+// Export of a year of sun times to the SD card, written by a worker thread
+// through a fixed-size buffer, see export_worker()
+#define EXPORT_BUFFER_SIZE 4096
+#define EXPORT_MAX_RECORD 768 // flush before the next day might not fit
+
+typedef enum {
+    ExportCsv,
+    ExportIcs,
+    ExportFormatCount
+} ExportFormat;
+
+static const char* export_format_labels[ExportFormatCount] = {"CSV", "iCalendar"};
+static const char* export_format_extensions[ExportFormatCount] = {"csv", "ics"};
+
+typedef enum {
+    ExportIdle,
+    ExportRunning,
+    ExportDone,
+    ExportFailed,
+    ExportCancelled
+} ExportStatus;
+
+typedef struct {
+    FuriThread* thread;
+    volatile bool cancel;         // set by the app thread
+    volatile int days_done;       // progress, written by the worker
+    volatile ExportStatus status;
+    int days_total;
+    ExportFormat format;
+    City city;                    // copied, the worker never touches app state
+    int year;
+    char dtstamp[24];             // iCalendar creation time, UTC
+    char slug[32];                // city name restricted to [A-Za-z0-9_]
+    char path[96];
+    size_t used;
+    char buffer[EXPORT_BUFFER_SIZE];
+} ExportJob;
+
+// Alerts: the chosen sun events of the favourite cities, in a min-heap ordered
+// by time. It holds the rest of today and all of tomorrow; a single one-shot
+// timer is armed for the head, see alerts_arm().
+#define ALERT_HEAP_SIZE (2 * ALERT_MAX_FAVOURITES * SunEventCount)
+#define ALERT_ROWS 4
+
+typedef struct {
+    uint32_t utc;          // event instant, seconds since epoch (UTC)
+    int16_t city;          // index for city_at()
+    int16_t local_minute;  // minutes after local midnight, for display
+    uint8_t event;         // SunEvent
+} AlertEntry;
+
+static AlertEntry alert_heap[ALERT_HEAP_SIZE];
+static int alert_count = 0;
+static uint32_t alert_filled_noon; // local noon of the last day in the heap
+
+static const char* sun_event_labels[SunEventCount] = {
+    "Astro. dawn", "Nautical dawn", "Civil dawn", "Sunrise",
+    "Sunset", "Civil dusk", "Nautical dusk", "Astro. dusk"};
+
+#define RANK_ROWS 5
+#define MOON_DISC_RADIUS 12
+
+// Everything the draw callback shows, filled from AppState by publish_render()
+// on the app thread. There are two: the GUI thread renders the front one while
+// the app thread fills the back one, and only the swap takes the mutex.
+typedef struct {
+    AppScreen screen;
+    AppMenu menu;
+    DateStep date_step;
+    CityText text;
+    char country_code[3];
+    bool has_prev_country;  // arrows of the country chooser
+    bool has_next_country;
+    bool has_city_menu;
+    int view_index;
+    // Moon: lit span of every row of the disc, as x offsets from the centre
+    MoonTimes moon_times;
+    int8_t moon_disc[2 * MOON_DISC_RADIUS + 1][2];
+    // Sun position: angles in tenths of a degree, dot offset on the sky dome
+    int16_t sun_azimuth_tenths;
+    int16_t sun_elevation_tenths;
+    int8_t sun_dot_x, sun_dot_y;
+    SunLight light;
+    // Alerts
+    uint8_t alert_events;
+    int alert_index;
+    char alert_header[24];  // favourites and home city
+    char alert_next[40];
+    // Export
+    ExportFormat export_format;
+    ExportStatus export_status;
+    float export_progress;
+    int export_year;
+    char export_file[48];
+    // Ranking: only the visible rows
+    RankMode rank_mode;
+    bool rank_country_only;
+    int rank_scroll;
+    int ranking_count;
+    struct {
+        char name[20];
+        char country_code[3];
+        float value_hours;
+    } rank_rows[RANK_ROWS];
+} RenderState;
+
 // Main application structure
 typedef struct {
-    FuriMessageQueue* input_queue;  // Queue for handling input events
+    FuriMessageQueue* input_queue;  // Queue for handling input events and ticks
+    FuriTimer* tick_timer;          // Runs only while the sun position or an export is shown
     ViewPort* view_port;            // ViewPort for rendering UI
     Gui* gui;                       // GUI instance
+    RenderState* render;            // Two snapshots for the draw callback
+    int render_front;               // Index of the one being shown
+    FuriMutex* render_mutex;        // Held while drawing and for the swap
     uint8_t current_screen;         // 0 = first screen, 1 = second screen 
 	int current_menu;	
 	int selected_country; 
 	int selected_city; // city ID from CSV file
-	bool csv_loaded;  // Status indicator
+	bool csv_loaded;  // Additional cities from the SD card
+	DateTime date;    // Date shown on the cities screen, starts at today
+	DateStep date_step;
+	SunState sun_state; // Warm-start seeds carried from the previous date
+	SunTimes sun_times; // Results for the selected city and date
+	CityText text;      // Formatted lines of the cities screen (see astro.h)
+	float utc_offset;   // UTC offset in effect for the selected city and date
+	MoonTimes moon_times; // Only computed while the moon screen is shown
+	SunLight light;       // Same for the golden/blue hour screen
+	SunTracker tracker;   // Live sun position, advanced on every tick
+	uint32_t tracker_timestamp; // RTC time the tracker was advanced to
+	double sun_azimuth;
+	double sun_elevation;
+	ExportFormat export_format;
+	ExportJob* export_job; // NULL unless an export ran since the screen was opened
+	FuriTimer* alert_timer;      // one-shot, armed for the next alert
+	volatile bool alert_due;     // set when it expires, see alert_timer_callback()
+	NotificationApp* notifications;
+	int16_t favourites[ALERT_MAX_FAVOURITES]; // indices for city_at()
+	int favourite_count;
+	int16_t home_city;           // zone of the RTC, for city_at(); -1 until chosen
+	uint8_t alert_events;        // bit mask over SunEvent
+	int alert_index;             // Selected row of the alerts screen
+	int view_index;     // Selected entry of the views menu
+	RankMode rank_mode;
+	bool rank_country_only; // Rank only the cities of the selected country
+	int rank_scroll;
 } AppState;
 
 // =============================================================================
@@ -201,25 +429,44 @@ static char* get_next_field(char** str_ptr) {
     return start;
 }
 
-// Load cities from file
+// Release the cities loaded from the SD card
+static void free_sd_cities(void) {
+    free(sd_cities);
+    free(sd_city_names);
+    sd_cities = NULL;
+    sd_city_names = NULL;
+    sd_city_count = 0;
+}
+
+// City by index: built-in cities first, then the ones from the SD card
+static const City* city_at(int index) {
+    if(index < builtin_city_count) return &builtin_cities[index];
+    return &sd_cities[index - builtin_city_count];
+}
+
+// Load additional cities from file, appended to the built-in ones
 bool load_cities_from_csv(const char* filepath) {
+    city_count = builtin_city_count;
     Storage* storage = furi_record_open(RECORD_STORAGE);
     File* file = storage_file_alloc(storage);
     
     if(!storage_file_open(file, filepath, FSAM_READ, FSOM_OPEN_EXISTING)) {
-        FURI_LOG_E(TAG, "Failed to open file");
+        FURI_LOG_I(TAG, "No city file on SD, built-in cities only");
         storage_file_free(file);
         furi_record_close(RECORD_STORAGE);
         return false;
     }
     
+    int capacity = MAX_CITIES - builtin_city_count;
+    sd_cities = malloc(capacity * sizeof(City));
+    sd_city_names = malloc(capacity * sizeof(sd_city_names[0]));
     char line[MAX_LINE_LENGTH];
     int line_pos = 0;
-    city_count = 0;
+    sd_city_count = 0;
     bool first_line = true;
     char byte;
     
-    while(storage_file_read(file, &byte, 1) == 1 && city_count < MAX_CITIES) {
+    while(storage_file_read(file, &byte, 1) == 1 && sd_city_count < capacity) {
         if(byte == '\n' || byte == '\r') {
             if(line_pos == 0) continue; // Skip empty lines
             
@@ -237,37 +484,39 @@ bool load_cities_from_csv(const char* filepath) {
             char* field;
             int field_num = 0;
             
+            City* city = &sd_cities[sd_city_count];
+            memset(city, 0, sizeof(City)); // optional fields default to 0
             while((field = get_next_field(&line_ptr)) != NULL && field_num < 9) {
                 switch(field_num) {
                     case 0: // Country code
-                        strncpy(cities[city_count].country_code, field, 2);
-                        cities[city_count].country_code[2] = '\0';
+                        strncpy(city->country_code, field, 2);
+                        city->country_code[2] = '\0';
                         break;
                     case 1: // UTC shift
-                        cities[city_count].utc_shift = parse_float(field);
+                        city->utc_shift = parse_float(field);
                         break;
                     case 2: // City name
-                        strncpy(cities[city_count].name, field, 31);
-                        cities[city_count].name[31] = '\0';
+                        snprintf(sd_city_names[sd_city_count], sizeof(sd_city_names[0]), "%.31s", field);
+                        city->name = sd_city_names[sd_city_count];
                         break;
                     case 3: // Longitude
-                        cities[city_count].longitude = parse_float(field);
+                        city->longitude = parse_float(field);
                         break;
                     case 4: // Latitude
-                        cities[city_count].latitude = parse_float(field);
+                        city->latitude = parse_float(field);
                         break;
                     case 5: // Elevation
-                        cities[city_count].elevation_m = parse_int(field);
+                        city->elevation_m = parse_int(field);
                         break;
                     case 8: // Capital Boolean flag
-                        cities[city_count].is_capital = (field[0] == 'Y' || field[0] == 'y');
+                        city->is_capital = (field[0] == 'Y' || field[0] == 'y');
                         break;
                 }
                 field_num++;
             }
             
-            if(field_num > 0) {
-                city_count++;
+            if(field_num > 5) { // country, offset, name, coordinates and elevation
+                sd_city_count++;
             }
             
             line_pos = 0; // Reset for next line
@@ -279,15 +528,20 @@ bool load_cities_from_csv(const char* filepath) {
     storage_file_close(file);
     storage_file_free(file);
     furi_record_close(RECORD_STORAGE);
-    FURI_LOG_I(TAG, "Loaded %d cities", city_count);
-    return city_count > 0;
+    FURI_LOG_I(TAG, "Loaded %d cities from SD", sd_city_count);
+    if(sd_city_count == 0) {
+        free_sd_cities();
+        return false;
+    }
+    city_count = builtin_city_count + sd_city_count;
+    return true;
 }
 
 // Count cities for each country
 void count_cities_per_country(void) {  
     for(int i = 0; i < city_count; i++) { 
         for(int j = 0; j < country_count; j++) { // loop overt the internal array
-            if(strcmp(cities[i].country_code, european_countries[j].code) == 0) {
+            if(strcmp(city_at(i)->country_code, european_countries[j].code) == 0) {
                 european_countries[j].city_count++;
                 break;
             }
@@ -300,8 +554,17 @@ void filter_cities_by_country(AppState* state) {
     filtered_city_count = 0;
     const char* country_code = european_countries[state->selected_country].code;
     
-    for(int i = 0; i < city_count; i++) {
-        if(strcmp(cities[i].country_code, country_code) == 0) {
+    // Built-in cities are grouped by country: take the range directly
+    for(int r = 0; r < builtin_city_range_count; r++) {
+        if(strcmp(builtin_city_ranges[r].country_code, country_code) == 0) {
+            for(int i = 0; i < builtin_city_ranges[r].count; i++) {
+                filtered_city_indices[filtered_city_count++] = builtin_city_ranges[r].first + i;
+            }
+            break;
+        }
+    }
+    for(int i = builtin_city_count; i < city_count; i++) {
+        if(strcmp(city_at(i)->country_code, country_code) == 0) {
             filtered_city_indices[filtered_city_count++] = i;
         }
     }
@@ -312,31 +575,905 @@ void filter_cities_by_country(AppState* state) {
     }
 }
 
-static City* get_current_city(AppState* state) {
+static const City* get_current_city(const AppState* state) {
     if(filtered_city_count == 0) return NULL;
-    return &cities[filtered_city_indices[state->selected_city]];
+    return city_at(filtered_city_indices[state->selected_city]);
 }
 
-// Calculates sunrise/sunset times for given date and location
-void calculate_sun_times(int year, int month, int day, double lat, double lon, 
-                         int* sunrise_h, int* sunrise_m, int* sunset_h, int* sunset_m) {
-    int n = (month <= 2) ? (month + 12) : month;
-    int y = (month <= 2) ? (year - 1) : year;
-    int day_of_year = (int)(275 * n / 9.0) - ((n + 9) / 12) * 
-                      ((1 + ((y - 4 * (y / 4) + 2) / 3))) - 30 + day;
-    
-	double lat_rad = (double)lat * 0.0174532925L;
-	double solar_decl = 0.4095L * sin(0.016906L * ((double)day_of_year - 80.086L));
-	double hour_angle = acos(-tan(lat_rad) * tan(solar_decl));
-	double solar_noon = 12.0L - ((double)lon / 15.0L);
+// Refresh the structure-of-arrays mirror after the cities were loaded
+void build_city_soa(void) {
+    for(int i = 0; i < city_count; i++) {
+        const City* city = city_at(i);
+        float lat = (float)city->latitude * ((float)M_PI / 180.0f);
+        city_soa.sin_lat[i] = sinf(lat);
+        city_soa.cos_lat[i] = cosf(lat);
+        city_soa.lng_hour[i] = (float)city->longitude / 15.0f;
+        city_soa.tz_rule[i] = tz_rule_for(city->country_code);
+    }
+    city_soa.tz_year = -1; // force update_city_tz() to resolve the rules
+    for(int slot = 0; slot < RTC_TZ_SLOTS; slot++) {
+        rtc_tz.city[slot] = -1;
+    }
+}
+
+// Resolve the DST transitions of all cities for the given year. This is only
+// done when the year changes; afterwards every UTC to local conversion is a
+// lookup with a single comparison (tz_offset_minutes()).
+static void update_city_tz(int year) {
+    if(city_soa.tz_year == year) return;
+    for(int i = 0; i < city_count; i++) {
+        tz_year_init(&city_soa.tz[i], city_soa.tz_rule[i], year,
+                     (int)lround(city_at(i)->utc_shift * 60));
+    }
+    city_soa.tz_year = year;
+}
+
+// Offset to UTC in minutes of a city at noon (local standard time) of a date
+static int city_offset_minutes(int index, const DateTime* date) {
+    update_city_tz(date->year);
+    return tz_noon_offset_minutes(&city_soa.tz[index], date->month, date->day);
+}
+
+// Same in hours
+static float city_utc_offset(int index, const DateTime* date) {
+    return city_offset_minutes(index, date) / 60.0f;
+}
+
+// Same as city_offset_minutes() for dates of the RTC, from rtc_tz
+static int rtc_city_offset_minutes(int index, const DateTime* date) {
+    int slot = 0;
+    while(slot < RTC_TZ_SLOTS && rtc_tz.city[slot] != index) slot++;
+    if(slot == RTC_TZ_SLOTS) {
+        slot = rtc_tz.next;
+        rtc_tz.next = (rtc_tz.next + 1) % RTC_TZ_SLOTS;
+        rtc_tz.city[slot] = index;
+        rtc_tz.tz[slot].year = -1;
+    }
+    if(rtc_tz.tz[slot].year != date->year) {
+        tz_year_init(&rtc_tz.tz[slot], city_soa.tz_rule[index], date->year,
+                     (int)lround(city_at(index)->utc_shift * 60));
+    }
+    return tz_noon_offset_minutes(&rtc_tz.tz[slot], date->month, date->day);
+}
+
+// The RTC is taken to run on the local time of the home city, which the user
+// chooses in the alerts view. Its UTC offset today turns RTC readings into UTC.
+static int32_t rtc_utc_offset_seconds(const AppState* state, const DateTime* today) {
+    if(state->home_city < 0) return 0;
+    return rtc_city_offset_minutes(state->home_city, today) * 60;
+}
+
+// Writes "hh:mm", or 'missing' for the -1 placeholders of the sun engine
+// ("--:--" on screen, empty in the export files)
+static void format_time(char* buffer, size_t size, int hour, int minute, const char* missing) {
+    if(hour < 0 || minute < 0) {
+        snprintf(buffer, size, "%s", missing);
+    } else {
+        // Sun and moon times stay below 100 hours; the modulo lets the
+        // compiler see that "hh:mm" fits
+        snprintf(buffer, size, "%02d:%02d", hour % 100, minute % 60);
+    }
+}
+
+// Same for fractional hours
+static void format_hours(char* buffer, size_t size, float hours) {
+    int minutes = (int)lroundf(hours * 60.0f);
+    format_time(buffer, size, minutes / 60, minutes % 60, "--:--");
+}
+
+// Writes value / 10^decimals as fixed-point decimal, e.g. (5252, 2) -> "52.52".
+// Integer formatting only, which keeps newlib's float printf out of the app.
+// All values shown (coordinates, offsets, angles) fit in 16 bits, so the
+// result never needs more than 7 characters ("-327.68").
+static void format_fixed(char* buffer, size_t size, int16_t value, int decimals, bool show_plus) {
+    int32_t scale = (decimals == 1) ? 10 : (decimals == 2) ? 100 : 1;
+    const char* sign = (value < 0) ? "-" : (show_plus ? "+" : "");
+    int32_t magnitude = labs(value);
+    if(decimals == 0) {
+        snprintf(buffer, size, "%s%ld", sign, (long)magnitude);
+    } else {
+        snprintf(buffer, size, "%s%ld.%0*ld", sign, (long)(magnitude / scale), decimals,
+                 (long)(magnitude % scale));
+    }
+}
+
+static bool is_favourite(const AppState* state, int index) {
+    for(int i = 0; i < state->favourite_count; i++) {
+        if(state->favourites[i] == index) return true;
+    }
+    return false;
+}
+
+// Rebuild the text lines of the cities screen for the selected city and date
+static void update_city_text(AppState* state) {
+    CityText* text = &state->text;
+    const DateTime* date = &state->date;
+    snprintf(text->date, sizeof(text->date), "%04d-%02d-%02d", date->year, date->month, date->day);
+
+    const City* city = get_current_city(state);
+    if(!city) {
+        text->name[0] = text->coordinates[0] = text->elevation[0] = '\0';
+        return;
+    }
+    strncpy(text->name, city->name, sizeof(text->name) - 1);
+    text->name[sizeof(text->name) - 1] = '\0';
+    text->is_capital = city->is_capital;
+    text->is_favourite = is_favourite(state, filtered_city_indices[state->selected_city]);
+    char lat[8], lon[8], offset[8];
+    format_fixed(lat, sizeof(lat), lround(fabs(city->latitude) * 100), 2, false);
+    format_fixed(lon, sizeof(lon), lround(fabs(city->longitude) * 100), 2, false);
+    snprintf(text->coordinates, sizeof(text->coordinates), "Lat:%s%c Lon:%s%c",
+        lat, (city->latitude >= 0 ? 'N' : 'S'), lon, (city->longitude >= 0 ? 'E' : 'W'));
+    format_fixed(offset, sizeof(offset), lroundf(state->utc_offset * 10), 1, true);
+    snprintf(text->elevation, sizeof(text->elevation), "Elev: %dm UTC %sh%s",
+        city->elevation_m, offset, (lroundf(state->utc_offset * 60) != lround(city->utc_shift * 60)) ? " DST" : "");
+
+    // "--:--" if the event does not happen
+    const SunTimes* sun_times = &state->sun_times;
+    format_time(text->sunrise, sizeof(text->sunrise), sun_times->sunrise_hour, sun_times->sunrise_minute, "--:--");
+    format_time(text->sunset, sizeof(text->sunset), sun_times->sunset_hour, sun_times->sunset_minute, "--:--");
+    format_time(text->daylength, sizeof(text->daylength), sun_times->daylength_hour, sun_times->daylength_minute, "--:--");
+}
+
+// Recompute the sun times for the selected city and date. The seeds
+// in sun_state stay valid while only the date moves, so stepping
+// through days costs about one solver pass per event.
+static void refresh_sun_times(AppState* state, bool location_changed) {
+    const City* city = get_current_city(state);
+    if(location_changed) {
+        sun_state_reset(&state->sun_state);
+    }
+    if(city) {
+        state->utc_offset = city_utc_offset(filtered_city_indices[state->selected_city], &state->date);
+        state->sun_times = sun_step(&state->sun_state,
+            state->date.year, state->date.month, state->date.day,
+            city->latitude, city->longitude, state->utc_offset);
+    }
+    update_city_text(state);
+}
+
+// Moon data for the selected city and date; much more expensive than the
+// sun, so only done on demand for the moon screen
+static void refresh_moon_times(AppState* state) {
+    const City* city = get_current_city(state);
+    if(!city) {
+        memset(&state->moon_times, -1, sizeof(state->moon_times));
+        return;
+    }
+    state->moon_times = moon(state->date.year, state->date.month, state->date.day,
+        city->latitude, city->longitude, state->utc_offset);
+}
+
+// Golden and blue hours for the selected city and date, on demand
+static void refresh_sun_light(AppState* state) {
+    const City* city = get_current_city(state);
+    if(!city) {
+        state->light = (SunLight){{-1, -1}, {-1, -1}, {-1, -1}, {-1, -1}};
+        return;
+    }
+    state->light = sun_light(state->date.year, state->date.month, state->date.day,
+        city->latitude, city->longitude, state->utc_offset);
+}
+
+// Full evaluation of the live sun position at the selected city. The RTC is
+// read in the home zone, see rtc_utc_offset_seconds().
+static void sync_sun_tracker(AppState* state) {
+    const City* city = get_current_city(state);
+    DateTime now;
+    furi_hal_rtc_get_datetime(&now);
+    state->tracker_timestamp = datetime_datetime_to_timestamp(&now);
+    if(!city) return;
+
+    DateTime ut;
+    datetime_timestamp_to_datetime(state->tracker_timestamp - rtc_utc_offset_seconds(state, &now), &ut);
+    sun_tracker_sync(&state->tracker, ut.year, ut.month, ut.day,
+        ut.hour + ut.minute / 60.0 + ut.second / 3600.0, city->latitude, city->longitude);
+    sun_tracker_position(&state->tracker, &state->sun_azimuth, &state->sun_elevation);
+}
+
+// Once per tick: rotate the hour angle by the elapsed seconds, which costs
+// a few multiplications; the ephemeris is only re-evaluated every few minutes
+static void advance_sun_tracker(AppState* state) {
+    uint32_t now = furi_hal_rtc_get_timestamp();
+    int elapsed = (int)(now - state->tracker_timestamp);
+    if(sun_tracker_advance(&state->tracker, elapsed)) {
+        sync_sun_tracker(state);
+        return;
+    }
+    state->tracker_timestamp = now;
+    sun_tracker_position(&state->tracker, &state->sun_azimuth, &state->sun_elevation);
+}
+
+static void tick_callback(void* context) {
+    AppState* app = context;
+    AppEvent event = {.type = EventTypeTick};
+    furi_message_queue_put(app->input_queue, &event, 0);
+}
+
+// Move the date by one step (day, week or month) in the given direction
+static void step_date(DateTime* date, DateStep step, int direction) {
+    if(step == DateStepMonth) {
+        int month = date->month + direction;
+        if(month < 1) {
+            month = 12;
+            date->year--;
+        } else if(month > 12) {
+            month = 1;
+            date->year++;
+        }
+        date->month = month;
+        // Clamp e.g. 31 January + 1 month to the end of February
+        uint8_t days = datetime_get_days_per_month(datetime_is_leap_year(date->year), month);
+        if(date->day > days) date->day = days;
+        return;
+    }
+    int32_t days = (step == DateStepWeek) ? 7 : 1;
+    uint32_t timestamp = datetime_datetime_to_timestamp(date);
+    timestamp += direction * days * 86400;
+    datetime_timestamp_to_datetime(timestamp, date);
+}
+
+// Keep the RANK_TOP_N smallest keys in ascending order. Once the list is
+// full most candidates are rejected by a single comparison, so there is
+// no need to sort all cities.
+static int rank_insert(int count, int city, float key, float value_hours) {
+    if(count == RANK_TOP_N && key >= ranking[count - 1].key) return count;
+    int pos = (count < RANK_TOP_N) ? count++ : count - 1;
+    while(pos > 0 && ranking[pos - 1].key > key) {
+        ranking[pos] = ranking[pos - 1];
+        pos--;
+    }
+    ranking[pos] = (RankEntry){.city = city, .key = key, .value_hours = value_hours};
+    return count;
+}
+
+// Wrap hours into 0..24
+static float wrap_hours(float hours) {
+    return hours - 24.0f * floorf(hours / 24.0f);
+}
+
+// Offset in hours of city 'index' at 'ut_hours' UT of the day starting at 'day_start'
+static float tz_offset_hours(int index, int32_t day_start, float ut_hours) {
+    return tz_offset_minutes(&city_soa.tz[index], day_start + (int32_t)(ut_hours * 60.0f)) / 60.0f;
+}
+
+// Rank all cities (or those of the selected country) for the selected date.
+// The date-dependent sun terms are evaluated once, then sunrise and sunset
+// of every city come out of one batch loop each.
+static void compute_ranking(AppState* state) {
+    const char* country_code = european_countries[state->selected_country].code;
+    ranking_count = 0;
+    state->rank_scroll = 0;
+    if(city_count == 0) return;
+
+    // Evaluate the sun near the events of the average city
+    float mean_lng_hour = 0;
+    for(int i = 0; i < city_count; i++) mean_lng_hour += city_soa.lng_hour[i];
+    mean_lng_hour /= city_count;
+
+    SunDayTerms rise_terms, set_terms;
+    const DateTime* date = &state->date;
+    update_city_tz(date->year);
+    int32_t day_start = tz_minute_of_year(date->year, date->month, date->day);
+    sun_day_terms(&rise_terms, date->year, date->month, date->day, 6.0 - mean_lng_hour);
+    sun_day_terms(&set_terms, date->year, date->month, date->day, 18.0 - mean_lng_hour);
+    sun_batch_event(&rise_terms, SunEventSunrise, city_soa.sin_lat, city_soa.cos_lat,
+                    city_soa.lng_hour, city_count, rank_rise_ut);
+    sun_batch_event(&set_terms, SunEventSunset, city_soa.sin_lat, city_soa.cos_lat,
+                    city_soa.lng_hour, city_count, rank_set_ut);
+
+    int count = 0;
+    for(int i = 0; i < city_count; i++) {
+        if(state->rank_country_only && strcmp(city_at(i)->country_code, country_code) != 0) {
+            continue;
+        }
+        float rise = rank_rise_ut[i];
+        float set = rank_set_ut[i];
+        switch(state->rank_mode) {
+            case RankSunrise:
+                if(!isnan(rise)) {
+                    count = rank_insert(count, i, rise, wrap_hours(rise + tz_offset_hours(i, day_start, rise)));
+                }
+                break;
+            case RankSunset:
+                if(!isnan(set)) {
+                    count = rank_insert(count, i, -set, wrap_hours(set + tz_offset_hours(i, day_start, set)));
+                }
+                break;
+            case RankDaylength: {
+                float length;
+                if(isnan(rise) || isnan(set)) {
+                    // No sunrise/sunset: polar day if the sun is on the city's side of the equator
+                    length = (rise_terms.sin_dec * city_soa.sin_lat[i] > 0) ? 24.0f : 0.0f;
+                } else {
+                    length = wrap_hours(set - rise);
+                }
+                count = rank_insert(count, i, -length, length);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    ranking_count = count;
+}
+
+// =============================================================================
+// EXPORT
+// =============================================================================
+// Append formatted text to the job buffer
+static void export_append(ExportJob* job, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(job->buffer + job->used, EXPORT_BUFFER_SIZE - job->used, format, args);
+    va_end(args);
+    if(n > 0) {
+        job->used += MIN((size_t)n, EXPORT_BUFFER_SIZE - job->used - 1);
+    }
+}
+
+// Write the buffer out in one block
+static bool export_flush(ExportJob* job, File* file) {
+    bool ok = storage_file_write(file, job->buffer, job->used) == job->used;
+    job->used = 0;
+    return ok;
+}
+
+// iCalendar UTC time of a local event on 'day'
+static void export_ics_time(char* buffer, size_t size, const DateTime* day,
+                            int hour, int minute, int offset_minutes) {
+    DateTime midnight = *day;
+    midnight.hour = midnight.minute = midnight.second = 0;
+    DateTime utc;
+    datetime_timestamp_to_datetime(datetime_datetime_to_timestamp(&midnight) +
+        (hour * 60 + minute - offset_minutes) * 60, &utc);
+    snprintf(buffer, size, "%04d%02d%02dT%02d%02d00Z",
+        utc.year, utc.month, utc.day, utc.hour, utc.minute);
+}
+
+static void export_ics_event(ExportJob* job, const DateTime* day, const char* kind,
+                             int hour, int minute, int offset_minutes, const char* description) {
+    if(hour < 0) return; // no sunrise/sunset on this day
+    char start[24];
+    export_ics_time(start, sizeof(start), day, hour, minute, offset_minutes);
+    export_append(job,
+        "BEGIN:VEVENT\r\n"
+        "UID:%04d%02d%02d-%s-%s@mitzi-astro\r\n"
+        "DTSTAMP:%s\r\n"
+        "DTSTART:%s\r\n"
+        "SUMMARY:%s %s\r\n"
+        "DESCRIPTION:%s\r\n"
+        "END:VEVENT\r\n",
+        day->year, day->month, day->day, kind, job->slug,
+        job->dtstamp, start, kind, job->city.name, description);
+}
+
+// One day of output
+static void export_record(ExportJob* job, const DateTime* day, const SunTimes* t, int offset_minutes) {
+    char ad[6], nd[6], cd[6], sr[6], ss[6], cu[6], nu[6], au[6], dl[6];
+    format_time(ad, sizeof(ad), t->astronomical_dawn_hour, t->astronomical_dawn_minute, "");
+    format_time(nd, sizeof(nd), t->nautical_dawn_hour, t->nautical_dawn_minute, "");
+    format_time(cd, sizeof(cd), t->civil_dawn_hour, t->civil_dawn_minute, "");
+    format_time(sr, sizeof(sr), t->sunrise_hour, t->sunrise_minute, "");
+    format_time(ss, sizeof(ss), t->sunset_hour, t->sunset_minute, "");
+    format_time(cu, sizeof(cu), t->civil_dusk_hour, t->civil_dusk_minute, "");
+    format_time(nu, sizeof(nu), t->nautical_dusk_hour, t->nautical_dusk_minute, "");
+    format_time(au, sizeof(au), t->astronomical_dusk_hour, t->astronomical_dusk_minute, "");
+    format_time(dl, sizeof(dl), t->daylength_hour, t->daylength_minute, "");
+
+    if(job->format == ExportCsv) {
+        export_append(job, "%04d-%02d-%02d,%s,%s,%s,%s,%s,%s,%s,%s,%s,%d\n",
+            day->year, day->month, day->day, ad, nd, cd, sr, ss, cu, nu, au, dl, offset_minutes);
+        return;
+    }
+    // Short descriptions, so that no iCalendar line needs folding (75 octets)
+    char description[64];
+    snprintf(description, sizeof(description), "Dawn astro %s naut %s civil %s",
+        ad[0] ? ad : "-", nd[0] ? nd : "-", cd[0] ? cd : "-");
+    export_ics_event(job, day, "Sunrise", t->sunrise_hour, t->sunrise_minute, offset_minutes, description);
+    snprintf(description, sizeof(description), "Dusk civil %s naut %s astro %s day %s",
+        cu[0] ? cu : "-", nu[0] ? nu : "-", au[0] ? au : "-", dl[0] ? dl : "-");
+    export_ics_event(job, day, "Sunset", t->sunset_hour, t->sunset_minute, offset_minutes, description);
+}
+
+// Worker thread: computes the year day by day (warm-started) and streams it to
+// the file. Memory use is the job struct, whatever the number of days.
+static int32_t export_worker(void* context) {
+    ExportJob* job = context;
+    Storage* storage = furi_record_open(RECORD_STORAGE);
+    File* file = storage_file_alloc(storage);
+    bool ok = storage_file_open(file, job->path, FSAM_WRITE, FSOM_CREATE_ALWAYS);
+
+    TzYear tz;
+    tz_year_init(&tz, tz_rule_for(job->city.country_code), job->year, (int)lround(job->city.utc_shift * 60));
+    SunState sun_state;
+    sun_state_reset(&sun_state);
+
+    job->used = 0;
+    if(job->format == ExportCsv) {
+        export_append(job, "# %s,%s\n", job->city.country_code, job->city.name);
+        export_append(job, "date,astronomical_dawn,nautical_dawn,civil_dawn,sunrise,sunset,"
+                           "civil_dusk,nautical_dusk,astronomical_dusk,daylength,utc_offset_minutes\n");
+    } else {
+        export_append(job, "BEGIN:VCALENDAR\r\nVERSION:2.0\r\nPRODID:-//f418.eu//Mitzi Astro//EN\r\n");
+    }
+
+    DateTime day = {.year = job->year, .month = 1, .day = 1, .hour = 12};
+    uint32_t first_noon = datetime_datetime_to_timestamp(&day);
+    for(int d = 0; ok && d < job->days_total && !job->cancel; d++) {
+        datetime_timestamp_to_datetime(first_noon + d * 86400, &day);
+        int offset_minutes = tz_noon_offset_minutes(&tz, day.month, day.day);
+        SunTimes times = sun_step(&sun_state, day.year, day.month, day.day,
+            job->city.latitude, job->city.longitude, offset_minutes / 60.0f);
+        export_record(job, &day, &times, offset_minutes);
+        if(job->used > EXPORT_BUFFER_SIZE - EXPORT_MAX_RECORD) {
+            ok = export_flush(job, file);
+        }
+        job->days_done = d + 1;
+    }
+    if(ok && !job->cancel) {
+        if(job->format == ExportIcs) export_append(job, "END:VCALENDAR\r\n");
+        ok = export_flush(job, file);
+    }
+
+    storage_file_close(file);
+    storage_file_free(file);
+    if(!ok || job->cancel) {
+        storage_simply_remove(storage, job->path); // no half-written files
+    }
+    furi_record_close(RECORD_STORAGE);
+    FURI_LOG_I(TAG, "Export %s: %d days", ok ? "done" : "failed", job->days_done);
+    job->status = job->cancel ? ExportCancelled : (ok ? ExportDone : ExportFailed);
+    return 0;
+}
+
+// Start exporting the year of the selected date for the selected city
+static void export_start(AppState* state) {
+    const City* city = get_current_city(state);
+    if(!city || (state->export_job && state->export_job->status == ExportRunning)) return;
+    if(!state->export_job) {
+        state->export_job = malloc(sizeof(ExportJob));
+        state->export_job->thread = NULL;
+    }
+    ExportJob* job = state->export_job;
+    if(job->thread) {
+        // The status is set just before the worker returns
+        furi_thread_join(job->thread);
+        furi_thread_free(job->thread);
+    }
+    job->cancel = false;
+    job->days_done = 0;
+    job->format = state->export_format;
+    job->city = *city;
+    job->year = state->date.year;
+    job->days_total = datetime_is_leap_year(job->year) ? 366 : 365;
+
+    // File name and UIDs from the city name, restricted to safe characters
+    size_t n = 0;
+    for(const char* c = city->name; *c && n < sizeof(job->slug) - 1; c++) {
+        bool safe = (*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || (*c >= '0' && *c <= '9');
+        job->slug[n++] = safe ? *c : '_';
+    }
+    job->slug[n] = '\0';
+    snprintf(job->path, sizeof(job->path), "%s%s_%d.%s", APP_DATA_PATH("sun_"), job->slug, job->year,
+        export_format_extensions[job->format]);
+
+    // Creation time from the RTC, read in the home zone like the alerts
+    DateTime now, utc;
+    furi_hal_rtc_get_datetime(&now);
+    datetime_timestamp_to_datetime(datetime_datetime_to_timestamp(&now) -
+        rtc_utc_offset_seconds(state, &now), &utc);
+    snprintf(job->dtstamp, sizeof(job->dtstamp), "%04d%02d%02dT%02d%02d%02dZ",
+        utc.year, utc.month, utc.day, utc.hour, utc.minute, utc.second);
+
+    job->status = ExportRunning;
+    job->thread = furi_thread_alloc_ex("AstroExport", 3 * 1024, export_worker, job);
+    furi_thread_start(job->thread);
+}
+
+// Cancel a running export and wait for the worker; frees the job
+static void export_stop(AppState* state) {
+    ExportJob* job = state->export_job;
+    if(!job) return;
+    job->cancel = true;
+    if(job->thread) {
+        furi_thread_join(job->thread);
+        furi_thread_free(job->thread);
+    }
+    free(job);
+    state->export_job = NULL;
+}
+
+// =============================================================================
+// ALERTS
+// =============================================================================
+static void alert_heap_push(AlertEntry entry) {
+    if(alert_count == ALERT_HEAP_SIZE) return;
+    int i = alert_count++;
+    while(i > 0 && alert_heap[(i - 1) / 2].utc > entry.utc) {
+        alert_heap[i] = alert_heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    alert_heap[i] = entry;
+}
+
+static AlertEntry alert_heap_pop(void) {
+    AlertEntry head = alert_heap[0];
+    AlertEntry last = alert_heap[--alert_count];
+    int i = 0;
+    for(;;) {
+        int child = 2 * i + 1;
+        if(child >= alert_count) break;
+        if(child + 1 < alert_count && alert_heap[child + 1].utc < alert_heap[child].utc) child++;
+        if(alert_heap[child].utc >= last.utc) break;
+        alert_heap[i] = alert_heap[child];
+        i = child;
+    }
+    if(alert_count > 0) alert_heap[i] = last;
+    return head;
+}
+
+// Local time of an event in minutes after midnight, -1 if it does not happen
+static int event_local_minute(const SunTimes* t, SunEvent event) {
+    int hour, minute;
+    switch(event) {
+        case SunEventAstronomicalDawn: hour = t->astronomical_dawn_hour; minute = t->astronomical_dawn_minute; break;
+        case SunEventNauticalDawn: hour = t->nautical_dawn_hour; minute = t->nautical_dawn_minute; break;
+        case SunEventCivilDawn: hour = t->civil_dawn_hour; minute = t->civil_dawn_minute; break;
+        case SunEventSunrise: hour = t->sunrise_hour; minute = t->sunrise_minute; break;
+        case SunEventSunset: hour = t->sunset_hour; minute = t->sunset_minute; break;
+        case SunEventCivilDusk: hour = t->civil_dusk_hour; minute = t->civil_dusk_minute; break;
+        case SunEventNauticalDusk: hour = t->nautical_dusk_hour; minute = t->nautical_dusk_minute; break;
+        default: hour = t->astronomical_dusk_hour; minute = t->astronomical_dusk_minute; break;
+    }
+    return (hour < 0 || minute < 0) ? -1 : hour * 60 + minute;
+}
+
+// Current instant, local and UTC, and local noon of today by the RTC
+typedef struct {
+    uint32_t now_local;
+    uint32_t now_utc;
+    uint32_t local_noon;
+} AlertClock;
+
+static AlertClock alert_clock(const AppState* state) {
+    DateTime today;
+    furi_hal_rtc_get_datetime(&today);
+    AlertClock clock;
+    clock.now_local = datetime_datetime_to_timestamp(&today);
+    clock.now_utc = clock.now_local - rtc_utc_offset_seconds(state, &today);
+    today.hour = 12;
+    today.minute = today.second = 0;
+    clock.local_noon = datetime_datetime_to_timestamp(&today);
+    return clock;
+}
+
+// Queue the chosen events of all favourites on the day of 'local_noon' that
+// are still ahead. Each city's own DST rule gives its offset on that day.
+static void alert_push_day(const AppState* state, uint32_t local_noon, const AlertClock* clock) {
+    DateTime day;
+    datetime_timestamp_to_datetime(local_noon, &day);
+    uint32_t local_midnight = local_noon - 12 * 3600;
+    for(int f = 0; f < state->favourite_count; f++) {
+        int index = state->favourites[f];
+        const City* city = city_at(index);
+        int offset = rtc_city_offset_minutes(index, &day);
+        SunState sun_state;
+        sun_state_reset(&sun_state);
+        SunTimes times = sun_step(&sun_state, day.year, day.month, day.day,
+            city->latitude, city->longitude, offset / 60.0f);
+        for(int e = 0; e < SunEventCount; e++) {
+            if(!(state->alert_events & (1 << e))) continue;
+            int minute = event_local_minute(&times, e);
+            if(minute < 0) continue; // e.g. no nautical dusk in a Nordic summer
+            uint32_t utc = local_midnight + (minute - offset) * 60;
+            if(utc <= clock->now_utc) continue;
+            alert_heap_push((AlertEntry){.utc = utc, .city = index, .local_minute = minute, .event = e});
+        }
+    }
+}
+
+// Any alerts to queue? Without a home city the RTC cannot be read as UTC.
+static bool alerts_enabled(const AppState* state) {
+    return state->home_city >= 0 && state->favourite_count > 0 && state->alert_events != 0;
+}
+
+// Arm the one-shot timer for the head of the queue. With an empty queue it
+// wakes up just after the next local midnight to queue another day.
+static void alerts_arm(AppState* state, const AlertClock* clock) {
+    furi_timer_stop(state->alert_timer);
+    if(!alerts_enabled(state)) return;
+    uint32_t delay = (alert_count > 0) ? alert_heap[0].utc - clock->now_utc
+                                       : clock->local_noon + 12 * 3600 + 60 - clock->now_local;
+    furi_timer_start(state->alert_timer, furi_ms_to_ticks(MAX(delay, 1u) * 1000));
+}
+
+// Start over after the home city, the favourites or the chosen events changed
+static void alerts_rebuild(AppState* state) {
+    AlertClock clock = alert_clock(state);
+    alert_count = 0;
+    alert_filled_noon = clock.local_noon + 86400;
+    if(alerts_enabled(state)) {
+        alert_push_day(state, clock.local_noon, &clock);
+        alert_push_day(state, alert_filled_noon, &clock);
+    }
+    alerts_arm(state, &clock);
+}
+
+// Timer expired: notify every event that is due, top the queue up once the
+// last queued day has begun, and arm the timer again
+static void alerts_fire(AppState* state) {
+    AlertClock clock = alert_clock(state);
+    while(alert_count > 0 && alert_heap[0].utc <= clock.now_utc + 1) {
+        AlertEntry entry = alert_heap_pop();
+        FURI_LOG_I(TAG, "Alert: %s in %s", sun_event_labels[entry.event], city_at(entry.city)->name);
+        notification_message(state->notifications, &sequence_double_vibro);
+        notification_message(state->notifications, &sequence_blink_blue_100);
+    }
+    while(clock.local_noon >= alert_filled_noon) {
+        alert_filled_noon += 86400;
+        alert_push_day(state, alert_filled_noon, &clock);
+    }
+    alerts_arm(state, &clock);
+}
+
+// Timer thread: flag the expiry and wake the main loop. If the queue is full
+// of key events the event is dropped, but the loop still sees the flag after
+// handling them, so no alert is lost and the timer is re-armed.
+static void alert_timer_callback(void* context) {
+    AppState* app = context;
+    app->alert_due = true;
+    AppEvent event = {.type = EventTypeAlert};
+    furi_message_queue_put(app->input_queue, &event, 0);
+}
+
+// Long OK on the cities screen: add or remove the selected city
+static void toggle_favourite(AppState* state) {
+    if(filtered_city_count == 0) return;
+    int index = filtered_city_indices[state->selected_city];
+    for(int i = 0; i < state->favourite_count; i++) {
+        if(state->favourites[i] == index) {
+            state->favourites[i] = state->favourites[--state->favourite_count];
+            alerts_rebuild(state);
+            update_city_text(state);
+            return;
+        }
+    }
+    if(state->favourite_count == ALERT_MAX_FAVOURITES) return;
+    state->favourites[state->favourite_count++] = index;
+    alerts_rebuild(state);
+    update_city_text(state);
+}
+
+// Long OK in the alerts view: the selected city becomes the home city
+static void set_home_city(AppState* state) {
+    if(filtered_city_count == 0) return;
+    state->home_city = filtered_city_indices[state->selected_city];
+    alerts_rebuild(state);
+}
+
+// =============================================================================
+// PREFERENCES
+// =============================================================================
+bool load_preferences(AstroPreferences* preferences) {
+    return saved_struct_load(PREFERENCES_FILE, preferences, sizeof(AstroPreferences),
+        PREFERENCES_MAGIC, PREFERENCES_VERSION);
+}
+
+bool save_preferences(const AstroPreferences* preferences) {
+    return saved_struct_save(PREFERENCES_FILE, preferences, sizeof(AstroPreferences),
+        PREFERENCES_MAGIC, PREFERENCES_VERSION);
+}
+
+static int find_country(const char* code) {
+    for(int i = 0; i < country_count; i++) {
+        if(strcmp(european_countries[i].code, code) == 0) return i;
+    }
+    return -1;
+}
+
+// Before the cities are loaded: skip the splash, and show the snapshot of the
+// last session if it was taken today
+static void apply_preferences_snapshot(AppState* state, const AstroPreferences* preferences) {
+    int country = find_country(preferences->country_code);
+    if(country < 0) return;
+    state->selected_country = country;
+    state->current_screen = ScreenCities;
+    if(preferences->snapshot_year == state->date.year &&
+       preferences->snapshot_month == state->date.month &&
+       preferences->snapshot_day == state->date.day) {
+        state->text = preferences->snapshot;
+        state->text.name[sizeof(state->text.name) - 1] = '\0';
+    }
+}
+
+// After the cities are loaded: select the saved city again, if it still exists
+static void restore_selection(AppState* state, const AstroPreferences* preferences) {
+    int country = find_country(preferences->country_code);
+    if(country < 0 || european_countries[country].city_count == 0) return;
+    state->selected_country = country;
+    filter_cities_by_country(state);
+    for(int i = 0; i < filtered_city_count; i++) {
+        if(strncmp(city_at(filtered_city_indices[i])->name, preferences->city_name,
+                   sizeof(preferences->city_name)) == 0) {
+            state->selected_city = i;
+            break;
+        }
+    }
+    if(preferences->screen == ScreenViews) {
+        state->view_index = MIN(preferences->view_index, ViewCount - 1);
+    }
+}
+
+// Index of a saved city for city_at(), -1 if it no longer exists
+static int find_saved_city(const char* country_code, const char* name, size_t name_size) {
+    for(int i = 0; i < city_count; i++) {
+        const City* city = city_at(i);
+        if(strncmp(city->country_code, country_code, 2) == 0 &&
+           strncmp(city->name, name, name_size) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// After the cities are loaded: home city, favourites and chosen events for the alerts
+static void restore_alerts(AppState* state, const AstroPreferences* preferences) {
+    state->alert_events = preferences->alert_events;
+    if(preferences->home.name[0]) {
+        state->home_city = find_saved_city(preferences->home.country_code, preferences->home.name,
+                                           sizeof(preferences->home.name));
+    }
+    for(int f = 0; f < ALERT_MAX_FAVOURITES && preferences->favourites[f].name[0]; f++) {
+        int index = find_saved_city(preferences->favourites[f].country_code, preferences->favourites[f].name,
+                                    sizeof(preferences->favourites[f].name));
+        if(index >= 0) state->favourites[state->favourite_count++] = index;
+    }
+}
+
+// Save the selection with a snapshot of today's results for the next launch
+static void store_preferences(AppState* state) {
+    AstroPreferences preferences;
+    memset(&preferences, 0, sizeof(preferences));
+    // Without a selected city only the alert settings are kept
+    const City* city = get_current_city(state);
+    if(city) {
+        memcpy(preferences.country_code, city->country_code, 2);
+        strncpy(preferences.city_name, city->name, sizeof(preferences.city_name) - 1);
+    }
+    // Live and export screens reopen at the views menu
+    preferences.screen = (state->current_screen >= ScreenViews) ? ScreenViews : ScreenCities;
+    preferences.view_index = state->view_index;
+    preferences.alert_events = state->alert_events;
+    for(int f = 0; f < state->favourite_count; f++) {
+        const City* favourite = city_at(state->favourites[f]);
+        memcpy(preferences.favourites[f].country_code, favourite->country_code, 2);
+        strncpy(preferences.favourites[f].name, favourite->name, sizeof(preferences.favourites[f].name) - 1);
+    }
+    if(state->home_city >= 0) {
+        const City* home = city_at(state->home_city);
+        memcpy(preferences.home.country_code, home->country_code, 2);
+        strncpy(preferences.home.name, home->name, sizeof(preferences.home.name) - 1);
+    }
+
+    furi_hal_rtc_get_datetime(&state->date);
+    refresh_sun_times(state, false);
+    preferences.snapshot_year = state->date.year;
+    preferences.snapshot_month = state->date.month;
+    preferences.snapshot_day = state->date.day;
+    preferences.snapshot = state->text;
+    if(!save_preferences(&preferences)) {
+        FURI_LOG_E(TAG, "Failed to save preferences");
+    }
+}
 
-	double sunrise_time = solar_noon - ((double)hour_angle * 3.81971863L);
-	double sunset_time = solar_noon + ((double)hour_angle * 3.81971863L);
+// =============================================================================
+// RENDER SNAPSHOT
+// =============================================================================
+// Copy what the current screen shows into 'render', doing all computation here
+// on the app thread
+static void fill_render_state(RenderState* render, const AppState* state) {
+    render->screen = state->current_screen;
+    render->menu = state->current_menu;
+    render->date_step = state->date_step;
+    render->text = state->text;
+    memcpy(render->country_code, european_countries[state->selected_country].code, 3);
+    render->has_prev_country = state->selected_country > 0;
+    render->has_next_country = state->selected_country < country_count - 1;
+    render->has_city_menu = european_countries[state->selected_country].city_count > 1;
+    render->view_index = state->view_index;
+
+    switch(state->current_screen) {
+        case ScreenMoon: {
+            render->moon_times = state->moon_times;
+            // The terminator is an ellipse whose half-width follows the illuminated fraction
+            const int r = MOON_DISC_RADIUS;
+            float k = state->moon_times.illumination_percent / 100.0f;
+            bool waxing = state->moon_times.phase < MoonFull; // lit on the right (northern hemisphere)
+            for(int dy = -r; dy <= r; dy++) {
+                int half = (int)lroundf(sqrtf((float)(r * r - dy * dy)));
+                int terminator = (int)lroundf(half * (1.0f - 2.0f * k));
+                render->moon_disc[dy + r][0] = waxing ? terminator : -half;
+                render->moon_disc[dy + r][1] = waxing ? half : -terminator;
+            }
+            break;
+        }
+        case ScreenPosition: {
+            render->sun_azimuth_tenths = lround(state->sun_azimuth * 10);
+            render->sun_elevation_tenths = lround(state->sun_elevation * 10);
+            // Sky dome of radius 26: zenith in the centre, north up
+            float dist = 26 * (90.0f - (float)state->sun_elevation) / 90.0f;
+            float az = (float)state->sun_azimuth * (float)M_PI / 180.0f;
+            render->sun_dot_x = (int)lroundf(dist * sinf(az));
+            render->sun_dot_y = -(int)lroundf(dist * cosf(az));
+            break;
+        }
+        case ScreenLight:
+            render->light = state->light;
+            break;
+        case ScreenAlerts:
+            render->alert_events = state->alert_events;
+            render->alert_index = state->alert_index;
+            snprintf(render->alert_header, sizeof(render->alert_header), "%d/%d home %.9s",
+                state->favourite_count, ALERT_MAX_FAVOURITES,
+                (state->home_city >= 0) ? city_at(state->home_city)->name : "-");
+            if(state->home_city < 0) {
+                const City* city = get_current_city(state);
+                snprintf(render->alert_next, sizeof(render->alert_next), "Hold OK: home = %.16s",
+                    city ? city->name : "?");
+            } else if(state->favourite_count == 0) {
+                snprintf(render->alert_next, sizeof(render->alert_next), "Hold OK on a city: favourite");
+            } else if(state->alert_events == 0) {
+                snprintf(render->alert_next, sizeof(render->alert_next), "OK selects events");
+            } else if(alert_count == 0) {
+                snprintf(render->alert_next, sizeof(render->alert_next), "No events until tomorrow");
+            } else {
+                const AlertEntry* next = &alert_heap[0];
+                snprintf(render->alert_next, sizeof(render->alert_next), "Next %02d:%02d %.10s",
+                    next->local_minute / 60, next->local_minute % 60, city_at(next->city)->name);
+            }
+            break;
+        case ScreenExport: {
+            const ExportJob* job = state->export_job;
+            render->export_format = state->export_format;
+            render->export_year = state->date.year;
+            render->export_status = job ? job->status : ExportIdle;
+            render->export_progress = job ? (float)job->days_done / job->days_total : 0;
+            render->export_file[0] = '\0';
+            if(job) {
+                strncpy(render->export_file, strrchr(job->path, '/') + 1, sizeof(render->export_file) - 1);
+                render->export_file[sizeof(render->export_file) - 1] = '\0';
+            }
+            break;
+        }
+        case ScreenRanking:
+            render->rank_mode = state->rank_mode;
+            render->rank_country_only = state->rank_country_only;
+            render->rank_scroll = state->rank_scroll;
+            render->ranking_count = ranking_count;
+            for(int row = 0; row < RANK_ROWS && state->rank_scroll + row < ranking_count; row++) {
+                const RankEntry* entry = &ranking[state->rank_scroll + row];
+                const City* city = city_at(entry->city);
+                strncpy(render->rank_rows[row].name, city->name, sizeof(render->rank_rows[row].name) - 1);
+                render->rank_rows[row].name[sizeof(render->rank_rows[row].name) - 1] = '\0';
+                memcpy(render->rank_rows[row].country_code, city->country_code, 3);
+                render->rank_rows[row].value_hours = entry->value_hours;
+            }
+            break;
+        default:
+            break;
+    }
+}
 
-	*sunrise_h = (int)sunrise_time;
-	*sunrise_m = (int)((sunrise_time - (double)*sunrise_h) * 60.0L);
-	*sunset_h = (int)sunset_time;
-	*sunset_m = (int)((sunset_time - (double)*sunset_h) * 60.0L);
+// Publish the current state to the draw callback: fill the back buffer
+// without any lock (the GUI thread only reads the front one), then swap
+static void publish_render(AppState* state) {
+    int back = 1 - state->render_front;
+    fill_render_state(&state->render[back], state);
+    furi_mutex_acquire(state->render_mutex, FuriWaitForever);
+    state->render_front = back;
+    furi_mutex_release(state->render_mutex);
+    view_port_update(state->view_port);
 }
 
 // =============================================================================
@@ -360,75 +1497,57 @@ static void draw_splash_screen(Canvas* canvas) {
     elements_button_center(canvas, "OK"); // for the OK button
 }
 
-static void draw_cities_screen(Canvas* canvas, AppState* state, DateTime* datetime) {
-    char buffer[64]; // buffer for string concatination
+static void draw_cities_screen(Canvas* canvas, const RenderState* state) {
+    const CityText* text = &state->text; // prepared by update_city_text()
     
     canvas_draw_icon(canvas, 1, -1, &I_icon_10x10);
     // Title
     canvas_set_font(canvas, FontPrimary);
     canvas_draw_str_aligned(canvas, 13, 1, AlignLeft, AlignTop, "City data"); 
-    // CSV load status indicator
-    if(!state->csv_loaded) {
-        canvas_draw_str_aligned(canvas, 126, 55, AlignRight, AlignTop, "Error: No CSV!");
-    }
     canvas_set_font(canvas, FontSecondary);
     // Display current date
-    snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d",datetime->year, datetime->month, datetime->day);
-    canvas_draw_str_aligned(canvas, 60, 2, AlignLeft, AlignTop, buffer);
+    canvas_draw_str_aligned(canvas, 60, 2, AlignLeft, AlignTop, text->date);
+    if(state->menu == MenuDate) {
+        canvas_draw_frame(canvas, 58, 0, 52, 11);
+    }
     
     // Country chooser
     canvas_draw_frame(canvas, 1, 11, 26, 12);
-    canvas_draw_str_aligned(canvas, 4, 13, AlignLeft, AlignTop, 
-        european_countries[state -> selected_country].code); 
+    canvas_draw_str_aligned(canvas, 4, 13, AlignLeft, AlignTop, state->country_code);
     // City chooser
     canvas_draw_frame(canvas, 28, 11, 100, 12);
-    City* city = get_current_city(state);
-    if(city) {
-        canvas_draw_str_aligned(canvas, 30, 13, AlignLeft, AlignTop, city->name);
-        if(city->is_capital) { // Draw capital indicator if applicable
+    // Only the cached text is used, so a snapshot from the last session can be
+    // shown before the cities are loaded
+    if(text->name[0]) {
+        canvas_draw_str_aligned(canvas, 30, 13, AlignLeft, AlignTop, text->name);
+        if(text->is_capital) { // Draw capital indicator if applicable
             canvas_draw_icon(canvas, 118, 1, &I_capital_10x10);
         }
+        if(text->is_favourite) { // Alerts are on for this city
+            canvas_draw_str_aligned(canvas, 112, 13, AlignLeft, AlignTop, "*");
+        }
         // Display latitude and longitude
-        snprintf(buffer, sizeof(buffer), "Lat:%.2f%c Lon:%.2f%c",
-            fabs(city->latitude), (city->latitude >= 0 ? 'N' : 'S'),
-            fabs(city->longitude), (city->longitude >= 0 ? 'E' : 'W'));
-        canvas_draw_str_aligned(canvas, 1, 24, AlignLeft, AlignTop, buffer);
+        canvas_draw_str_aligned(canvas, 1, 24, AlignLeft, AlignTop, text->coordinates);
         // Display elevation and time zone
-        snprintf(buffer, sizeof(buffer), "Elev: %dm UTC %+.1fh", 
-            city->elevation_m, city->utc_shift);
-        canvas_draw_str_aligned(canvas, 1, 33, AlignLeft, AlignTop, buffer);
+        canvas_draw_str_aligned(canvas, 1, 33, AlignLeft, AlignTop, text->elevation);
         
-        // Calculate sun times
-        int sunrise_h, sunrise_m, sunset_h, sunset_m;
-        calculate_sun_times(datetime->year, datetime->month, datetime->day,
-                           city->latitude, city->longitude,
-                           &sunrise_h, &sunrise_m, &sunset_h, &sunset_m);
-
-        // Calculate day length
-        int day_minutes = (sunset_h * 60 + sunset_m) - (sunrise_h * 60 + sunrise_m);
-        int day_h = day_minutes / 60;
-        int day_m = day_minutes % 60;
-
         // Sunset and sunrise output
         canvas_draw_icon(canvas, 1, 41, &I_Sunrise_10x10);
-        snprintf(buffer, sizeof(buffer), "%02d:%02d", sunrise_h, sunrise_m);
-        canvas_draw_str_aligned(canvas, 13, 43, AlignLeft, AlignTop, buffer);
+        canvas_draw_str_aligned(canvas, 13, 43, AlignLeft, AlignTop, text->sunrise);
 
         canvas_draw_icon(canvas, 45, 41, &I_Sunset_10x10);
-        snprintf(buffer, sizeof(buffer), "%02d:%02d", sunset_h, sunset_m);
-        canvas_draw_str_aligned(canvas, 57, 43, AlignLeft, AlignTop, buffer);
+        canvas_draw_str_aligned(canvas, 57, 43, AlignLeft, AlignTop, text->sunset);
 
         canvas_draw_icon(canvas, 89, 41, &I_HourGlas_10x10);
-        snprintf(buffer, sizeof(buffer), "%02d:%02d", day_h, day_m);
-        canvas_draw_str_aligned(canvas, 101, 43, AlignLeft, AlignTop, buffer);
+        canvas_draw_str_aligned(canvas, 101, 43, AlignLeft, AlignTop, text->daylength);
     }
     // Navigation arrows for the country and city chooser
-    switch(state->current_menu) {
+    switch(state->menu) {
         case MenuCountry:
-            if(state->selected_country > 0) {
+            if(state->has_prev_country) {
                 canvas_draw_icon(canvas, 18, 12, &I_ButtonUp_7x4);
             }
-            if(state->selected_country < country_count - 1) {
+            if(state->has_next_country) {
                 canvas_draw_icon(canvas, 18, 17, &I_ButtonDown_7x4);
             }
             break;
@@ -436,52 +1555,412 @@ static void draw_cities_screen(Canvas* canvas, AppState* state, DateTime* dateti
             canvas_draw_icon(canvas, 119, 12, &I_ButtonUp_7x4);
             canvas_draw_icon(canvas, 119, 17, &I_ButtonDown_7x4);
             break;
+        case MenuDate:
+            canvas_draw_icon(canvas, 111, 1, &I_ButtonUp_7x4);
+            canvas_draw_icon(canvas, 111, 6, &I_ButtonDown_7x4);
+            break;
     }
 	
 	// Draw navigation hints at bottom
-	if(state->current_menu == MenuCountry) {
-		// Only show "City" hint if there's more than one city to choose from
-		if(european_countries[state->selected_country].city_count > 1) {
-			elements_button_right(canvas, "City");
-		}
-	} else { // MenuCity
-		elements_button_left(canvas, "Country");
+	bool has_city_menu = state->has_city_menu;
+	switch(state->menu) {
+		case MenuCountry:
+			// Only show "City" hint if there's more than one city to choose from
+			elements_button_right(canvas, has_city_menu ? "City" : "Date");
+			elements_button_center(canvas, "More");
+			break;
+		case MenuCity:
+			elements_button_left(canvas, "Country");
+			elements_button_right(canvas, "Date");
+			elements_button_center(canvas, "More");
+			break;
+		case MenuDate:
+			elements_button_left(canvas, has_city_menu ? "City" : "Country");
+			elements_button_center(canvas, date_step_labels[state->date_step]);
+			break;
 	}
     // Verbose area
     // snprintf(buffer, sizeof(buffer), "Cntry %i [%i cities]. City %i/%i", state -> selected_country, european_countries[state -> selected_country].city_count,state->selected_city, filtered_city_indices[state->selected_city]);
     // canvas_draw_str_aligned(canvas, 1, 53, AlignLeft, AlignTop, buffer);
 }
 
+#define VIEW_ROWS 4
+
+static void draw_views_screen(Canvas* canvas, const RenderState* state) {
+    canvas_draw_icon(canvas, 1, -1, &I_icon_10x10);
+    canvas_set_font(canvas, FontPrimary);
+    canvas_draw_str_aligned(canvas, 13, 1, AlignLeft, AlignTop, "Views");
+    canvas_set_font(canvas, FontSecondary);
+    // Four rows fit above the button; scroll to keep the selection visible
+    int first = MAX(0, state->view_index - (VIEW_ROWS - 1));
+    for(int i = first; i < ViewCount && i < first + VIEW_ROWS; i++) {
+        int y = 13 + (i - first) * 10;
+        if(i == state->view_index) {
+            canvas_draw_box(canvas, 0, y - 1, 128, 10);
+            canvas_set_color(canvas, ColorWhite);
+        }
+        canvas_draw_str_aligned(canvas, 4, y, AlignLeft, AlignTop, view_labels[i]);
+        canvas_set_color(canvas, ColorBlack);
+    }
+    elements_scrollbar(canvas, state->view_index, ViewCount);
+    elements_button_center(canvas, "Open");
+}
+
+// Moon disc with the lit part filled, row by row (spans from fill_render_state())
+static void draw_moon_disc(Canvas* canvas, int cx, int cy, const RenderState* state) {
+    const int r = MOON_DISC_RADIUS;
+    canvas_draw_circle(canvas, cx, cy, r);
+    // Nothing lit at new moon: the spans would collapse to dots on the edge
+    if(state->moon_times.illumination_percent <= 0) return;
+    for(int dy = -r; dy <= r; dy++) {
+        canvas_draw_line(canvas, cx + state->moon_disc[dy + r][0], cy + dy,
+            cx + state->moon_disc[dy + r][1], cy + dy);
+    }
+}
+
+static void draw_moon_screen(Canvas* canvas, const RenderState* state) {
+    char buffer[32];
+    const MoonTimes* moon_times = &state->moon_times;
+
+    canvas_set_font(canvas, FontPrimary);
+    canvas_draw_str_aligned(canvas, 1, 1, AlignLeft, AlignTop, "Moon");
+    canvas_set_font(canvas, FontSecondary);
+    canvas_draw_str_aligned(canvas, 126, 2, AlignRight, AlignTop, state->text.date);
+    canvas_draw_str_aligned(canvas, 1, 13, AlignLeft, AlignTop, state->text.name);
+
+    if(moon_times->illumination_percent >= 0) {
+        canvas_draw_str_aligned(canvas, 1, 23, AlignLeft, AlignTop, moon_phase_labels[moon_times->phase]);
+        snprintf(buffer, sizeof(buffer), "Illuminated: %d%%", moon_times->illumination_percent);
+        canvas_draw_str_aligned(canvas, 1, 32, AlignLeft, AlignTop, buffer);
+        format_time(buffer, sizeof(buffer), moon_times->moonrise_hour, moon_times->moonrise_minute, "--:--");
+        canvas_draw_str_aligned(canvas, 1, 42, AlignLeft, AlignTop, "Rise");
+        canvas_draw_str_aligned(canvas, 24, 42, AlignLeft, AlignTop, buffer);
+        format_time(buffer, sizeof(buffer), moon_times->moonset_hour, moon_times->moonset_minute, "--:--");
+        canvas_draw_str_aligned(canvas, 54, 42, AlignLeft, AlignTop, "Set");
+        canvas_draw_str_aligned(canvas, 72, 42, AlignLeft, AlignTop, buffer);
+    }
+    draw_moon_disc(canvas, 112, 28, state);
+    // Up/Down steps the date
+    canvas_draw_icon(canvas, 66, 1, &I_ButtonUp_7x4);
+    canvas_draw_icon(canvas, 66, 6, &I_ButtonDown_7x4);
+}
+
+// Sky dome: horizon circle with north up and east right, zenith in the centre
+static void draw_position_screen(Canvas* canvas, const RenderState* state) {
+    char buffer[32];
+
+    canvas_set_font(canvas, FontPrimary);
+    canvas_draw_str_aligned(canvas, 1, 1, AlignLeft, AlignTop, "Sun now");
+    canvas_set_font(canvas, FontSecondary);
+    if(!state->text.name[0]) return;
+    snprintf(buffer, sizeof(buffer), "%.13s", state->text.name); // leave room for the dome
+    canvas_draw_str_aligned(canvas, 1, 13, AlignLeft, AlignTop, buffer);
+
+    char angle[8];
+    format_fixed(angle, sizeof(angle), state->sun_azimuth_tenths, 1, false);
+    snprintf(buffer, sizeof(buffer), "Az:  %s", angle);
+    canvas_draw_str_aligned(canvas, 1, 25, AlignLeft, AlignTop, buffer);
+    format_fixed(angle, sizeof(angle), state->sun_elevation_tenths, 1, false);
+    snprintf(buffer, sizeof(buffer), "Elev: %s", angle);
+    canvas_draw_str_aligned(canvas, 1, 35, AlignLeft, AlignTop, buffer);
+    if(state->sun_elevation_tenths < 0) {
+        canvas_draw_str_aligned(canvas, 1, 45, AlignLeft, AlignTop, "below horizon");
+    }
+
+    const int cx = 100, cy = 34, r = 26;
+    canvas_draw_circle(canvas, cx, cy, r);
+    canvas_draw_dot(canvas, cx, cy);
+    canvas_draw_str_aligned(canvas, cx, cy - r - 7, AlignCenter, AlignTop, "N");
+    canvas_draw_line(canvas, cx - r, cy, cx - r + 3, cy);
+    canvas_draw_line(canvas, cx + r - 3, cy, cx + r, cy);
+    canvas_draw_line(canvas, cx, cy + r - 3, cx, cy + r);
+    if(state->sun_elevation_tenths >= 0) {
+        canvas_draw_disc(canvas, cx + state->sun_dot_x, cy + state->sun_dot_y, 2);
+    }
+}
+
+// One "label  hh:mm - hh:mm" row of the golden/blue hour screen
+static void draw_light_row(Canvas* canvas, int y, const char* label, const SunInterval* interval) {
+    char start[8], end[8], buffer[20];
+    format_hours(start, sizeof(start), interval->start);
+    format_hours(end, sizeof(end), interval->end);
+    snprintf(buffer, sizeof(buffer), "%s - %s", start, end);
+    canvas_draw_str_aligned(canvas, 1, y, AlignLeft, AlignTop, label);
+    canvas_draw_str_aligned(canvas, 126, y, AlignRight, AlignTop, buffer);
+}
+
+static void draw_light_screen(Canvas* canvas, const RenderState* state) {
+    canvas_set_font(canvas, FontPrimary);
+    canvas_draw_str_aligned(canvas, 1, 1, AlignLeft, AlignTop, "Light");
+    canvas_set_font(canvas, FontSecondary);
+    canvas_draw_str_aligned(canvas, 126, 2, AlignRight, AlignTop, state->text.date);
+    canvas_draw_str_aligned(canvas, 1, 13, AlignLeft, AlignTop, state->text.name);
+    draw_light_row(canvas, 24, "Blue", &state->light.blue_morning);
+    draw_light_row(canvas, 33, "Golden", &state->light.golden_morning);
+    draw_light_row(canvas, 44, "Golden", &state->light.golden_evening);
+    draw_light_row(canvas, 53, "Blue", &state->light.blue_evening);
+    // Up/Down steps the date
+    canvas_draw_icon(canvas, 66, 1, &I_ButtonUp_7x4);
+    canvas_draw_icon(canvas, 66, 6, &I_ButtonDown_7x4);
+}
+
+static void draw_alerts_screen(Canvas* canvas, const RenderState* state) {
+    canvas_set_font(canvas, FontPrimary);
+    canvas_draw_str_aligned(canvas, 1, 1, AlignLeft, AlignTop, "Alerts");
+    canvas_set_font(canvas, FontSecondary);
+    canvas_draw_str_aligned(canvas, 122, 2, AlignRight, AlignTop, state->alert_header);
+
+    int first = MAX(0, state->alert_index - (ALERT_ROWS - 1));
+    for(int i = first; i < SunEventCount && i < first + ALERT_ROWS; i++) {
+        int y = 13 + (i - first) * 10;
+        if(i == state->alert_index) {
+            canvas_draw_box(canvas, 0, y - 1, 124, 10);
+            canvas_set_color(canvas, ColorWhite);
+        }
+        canvas_draw_frame(canvas, 3, y + 1, 7, 7);
+        if(state->alert_events & (1 << i)) {
+            canvas_draw_box(canvas, 5, y + 3, 3, 3);
+        }
+        canvas_draw_str_aligned(canvas, 14, y, AlignLeft, AlignTop, sun_event_labels[i]);
+        canvas_set_color(canvas, ColorBlack);
+    }
+    elements_scrollbar(canvas, state->alert_index, SunEventCount);
+    canvas_draw_str_aligned(canvas, 1, 54, AlignLeft, AlignTop, state->alert_next);
+}
+
+static void draw_export_screen(Canvas* canvas, const RenderState* state) {
+    char buffer[48];
+
+    canvas_set_font(canvas, FontPrimary);
+    snprintf(buffer, sizeof(buffer), "Export %d", state->export_year);
+    canvas_draw_str_aligned(canvas, 1, 1, AlignLeft, AlignTop, buffer);
+    canvas_set_font(canvas, FontSecondary);
+    if(!state->text.name[0]) return;
+    canvas_draw_str_aligned(canvas, 1, 13, AlignLeft, AlignTop, state->text.name);
+    snprintf(buffer, sizeof(buffer), "< %s >", export_format_labels[state->export_format]);
+    canvas_draw_str_aligned(canvas, 1, 23, AlignLeft, AlignTop, buffer);
+
+    switch(state->export_status) {
+        case ExportRunning:
+            elements_progress_bar(canvas, 1, 34, 126, state->export_progress);
+            canvas_draw_str_aligned(canvas, 1, 46, AlignLeft, AlignTop, "Back to cancel");
+            return;
+        case ExportDone:
+            canvas_draw_str_aligned(canvas, 1, 34, AlignLeft, AlignTop, "Saved to apps_data:");
+            canvas_draw_str_aligned(canvas, 1, 43, AlignLeft, AlignTop, state->export_file);
+            break;
+        case ExportFailed:
+            canvas_draw_str_aligned(canvas, 1, 34, AlignLeft, AlignTop, "Error: could not write file");
+            break;
+        case ExportCancelled:
+            canvas_draw_str_aligned(canvas, 1, 34, AlignLeft, AlignTop, "Cancelled");
+            break;
+        default:
+            break;
+    }
+    elements_button_center(canvas, "Start");
+}
+
+static void draw_ranking_screen(Canvas* canvas, const RenderState* state) {
+    char buffer[32];
+    canvas_set_font(canvas, FontPrimary);
+    canvas_draw_str_aligned(canvas, 1, 1, AlignLeft, AlignTop, rank_mode_labels[state->rank_mode]);
+    canvas_set_font(canvas, FontSecondary);
+    canvas_draw_str_aligned(canvas, 126, 2, AlignRight, AlignTop,
+        state->rank_country_only ? state->country_code : "All");
+
+    if(state->ranking_count == 0) {
+        canvas_draw_str_aligned(canvas, 64, 30, AlignCenter, AlignTop, "No cities to rank");
+    }
+    for(int row = 0; row < RANK_ROWS && state->rank_scroll + row < state->ranking_count; row++) {
+        int y = 12 + row * 9;
+        snprintf(buffer, sizeof(buffer), "%2d %.15s", state->rank_scroll + row + 1, state->rank_rows[row].name);
+        canvas_draw_str_aligned(canvas, 1, y, AlignLeft, AlignTop, buffer);
+        canvas_draw_str_aligned(canvas, 92, y, AlignLeft, AlignTop, state->rank_rows[row].country_code);
+        format_hours(buffer, sizeof(buffer), state->rank_rows[row].value_hours);
+        canvas_draw_str_aligned(canvas, 122, y, AlignRight, AlignTop, buffer);
+    }
+    if(state->ranking_count > RANK_ROWS) {
+        elements_scrollbar(canvas, state->rank_scroll, state->ranking_count - RANK_ROWS + 1);
+    }
+    elements_button_center(canvas, state->rank_country_only ? "All" : "Country");
+}
+
 // =============================================================================
 // MAIN CALLBACK - called whenever the screen needs to be redrawn
 // =============================================================================
+// Runs on the GUI thread and only renders the front snapshot; the app thread
+// never writes to it while the mutex is held here (see publish_render())
 void draw_callback(Canvas* canvas, void* context) {
-    AppState* state = context;  // Get app context to check current screen
+    AppState* app = context;
+    furi_mutex_acquire(app->render_mutex, FuriWaitForever);
+    const RenderState* state = &app->render[app->render_front];
 
     // Clear the canvas and set drawing color to black
     canvas_clear(canvas);
     canvas_set_color(canvas, ColorBlack);
-	// Get current time
-	DateTime datetime;
-    furi_hal_rtc_get_datetime(&datetime);
-	
-    switch (state -> current_screen) {
+    switch (state->screen) {
 		case ScreenSplash: // Splash screen ===================================
 			// ================================================================
             draw_splash_screen(canvas);
 			break;	
 		case ScreenCities: // City chooser ======================================
 			// ==================================================================
-            draw_cities_screen(canvas, state, &datetime);
+            draw_cities_screen(canvas, state);
 			break;	
+		case ScreenViews:
+			draw_views_screen(canvas, state);
+			break;
+		case ScreenRanking:
+			draw_ranking_screen(canvas, state);
+			break;
+		case ScreenMoon:
+			draw_moon_screen(canvas, state);
+			break;
+		case ScreenPosition:
+			draw_position_screen(canvas, state);
+			break;
+		case ScreenLight:
+			draw_light_screen(canvas, state);
+			break;
+		case ScreenAlerts:
+			draw_alerts_screen(canvas, state);
+			break;
+		case ScreenExport:
+			draw_export_screen(canvas, state);
+			break;
     }
+    furi_mutex_release(app->render_mutex);
 }
 
 void input_callback(InputEvent* event, void* context) {
     AppState* app = context;
 	// Put the input event into the message queue for processing
     // Timeout of 0 means non-blocking
-    furi_message_queue_put(app->input_queue, event, 0);
+    AppEvent app_event = {.type = EventTypeKey, .input = *event};
+    furi_message_queue_put(app->input_queue, &app_event, 0);
+}
+
+// Key handling for the screens reached through the views menu.
+// A long Back is left to the main loop to exit the app.
+static void handle_view_input(AppState* app, InputEvent* input) {
+    bool pressed = (input->type == InputTypePress || input->type == InputTypeRepeat);
+    switch(app->current_screen) {
+        case ScreenViews:
+            if(input->key == InputKeyUp && pressed && app->view_index > 0) {
+                app->view_index--;
+            } else if(input->key == InputKeyDown && pressed && app->view_index < ViewCount - 1) {
+                app->view_index++;
+            } else if(input->key == InputKeyOk && input->type == InputTypeShort) {
+                switch(app->view_index) {
+                    case ViewRanking:
+                        compute_ranking(app);
+                        app->current_screen = ScreenRanking;
+                        break;
+                    case ViewMoon:
+                        refresh_moon_times(app);
+                        app->current_screen = ScreenMoon;
+                        break;
+                    case ViewPosition:
+                        sync_sun_tracker(app);
+                        furi_timer_start(app->tick_timer, furi_ms_to_ticks(1000));
+                        app->current_screen = ScreenPosition;
+                        break;
+                    case ViewLight:
+                        refresh_sun_light(app);
+                        app->current_screen = ScreenLight;
+                        break;
+                    case ViewAlerts:
+                        app->current_screen = ScreenAlerts;
+                        break;
+                    case ViewExport:
+                        app->current_screen = ScreenExport;
+                        break;
+                }
+            } else if(input->key == InputKeyBack && input->type == InputTypeShort) {
+                app->current_screen = ScreenCities;
+            }
+            break;
+        case ScreenRanking:
+            if(input->key == InputKeyUp && pressed && app->rank_scroll > 0) {
+                app->rank_scroll--;
+            } else if(input->key == InputKeyDown && pressed &&
+                      app->rank_scroll + RANK_ROWS < ranking_count) {
+                app->rank_scroll++;
+            } else if((input->key == InputKeyLeft || input->key == InputKeyRight) &&
+                      input->type == InputTypePress) {
+                int step = (input->key == InputKeyRight) ? 1 : RankModeCount - 1;
+                app->rank_mode = (app->rank_mode + step) % RankModeCount;
+                compute_ranking(app);
+            } else if(input->key == InputKeyOk && input->type == InputTypeShort) {
+                app->rank_country_only = !app->rank_country_only;
+                compute_ranking(app);
+            } else if(input->key == InputKeyBack && input->type == InputTypeShort) {
+                app->current_screen = ScreenViews;
+            }
+            break;
+        case ScreenMoon:
+            // Up/Down step through days, like the date menu of the cities screen
+            if((input->key == InputKeyUp || input->key == InputKeyDown) && pressed) {
+                step_date(&app->date, DateStepDay, (input->key == InputKeyUp) ? +1 : -1);
+                refresh_sun_times(app, false);
+                refresh_moon_times(app);
+            } else if(input->key == InputKeyBack && input->type == InputTypeShort) {
+                app->current_screen = ScreenViews;
+            }
+            break;
+        case ScreenAlerts:
+            if(input->key == InputKeyUp && pressed && app->alert_index > 0) {
+                app->alert_index--;
+            } else if(input->key == InputKeyDown && pressed && app->alert_index < SunEventCount - 1) {
+                app->alert_index++;
+            } else if(input->key == InputKeyOk && input->type == InputTypeShort) {
+                app->alert_events ^= 1 << app->alert_index;
+                alerts_rebuild(app);
+            } else if(input->key == InputKeyOk && input->type == InputTypeLong) {
+                set_home_city(app);
+            } else if(input->key == InputKeyBack && input->type == InputTypeShort) {
+                app->current_screen = ScreenViews;
+            }
+            break;
+        case ScreenLight:
+            if((input->key == InputKeyUp || input->key == InputKeyDown) && pressed) {
+                step_date(&app->date, DateStepDay, (input->key == InputKeyUp) ? +1 : -1);
+                refresh_sun_times(app, false);
+                refresh_sun_light(app);
+            } else if(input->key == InputKeyBack && input->type == InputTypeShort) {
+                app->current_screen = ScreenViews;
+            }
+            break;
+        case ScreenPosition:
+            if(input->key == InputKeyBack && input->type == InputTypeShort) {
+                furi_timer_stop(app->tick_timer);
+                app->current_screen = ScreenViews;
+            }
+            break;
+        case ScreenExport: {
+            bool running = app->export_job && app->export_job->status == ExportRunning;
+            if((input->key == InputKeyLeft || input->key == InputKeyRight) &&
+               input->type == InputTypePress && !running) {
+                app->export_format = (app->export_format + 1) % ExportFormatCount;
+            } else if(input->key == InputKeyOk && input->type == InputTypeShort && !running) {
+                export_start(app);
+                // Ticks redraw the progress bar while the worker runs
+                furi_timer_start(app->tick_timer, furi_ms_to_ticks(250));
+            } else if(input->key == InputKeyBack && input->type == InputTypeShort) {
+                if(running) {
+                    app->export_job->cancel = true; // the worker finishes on its own
+                } else {
+                    export_stop(app);
+                    furi_timer_stop(app->tick_timer);
+                    app->current_screen = ScreenViews;
+                }
+            }
+            break;
+        }
+        default:
+            break;
+    }
 }
 
 // =============================================================================
@@ -495,19 +1974,52 @@ int32_t astro_main(void* p) {
 	app.current_menu = MenuCountry; // Start on menu chooser
 	app.selected_country = 0;
 	app.selected_city = 0;
+	furi_hal_rtc_get_datetime(&app.date); // Start at today
+	app.date_step = DateStepDay;
+	sun_state_reset(&app.sun_state);
+	memset(&app.sun_times, -1, sizeof(app.sun_times));
+	memset(&app.text, 0, sizeof(app.text));
+	app.utc_offset = 0;
+	app.sun_azimuth = 0;
+	app.sun_elevation = 0;
+	app.export_format = ExportCsv;
+	app.export_job = NULL;
+	app.favourite_count = 0;
+	app.home_city = -1;
+	app.alert_due = false;
+	app.alert_events = 0;
+	app.alert_index = 0;
+	app.view_index = 0;
+	app.rank_mode = RankSunrise;
+	app.rank_country_only = false;
+	app.rank_scroll = 0;
 	
 	// Allocate resources for rendering and 
     app.view_port = view_port_alloc(); // for rendering
-    app.input_queue = furi_message_queue_alloc(1, sizeof(InputEvent)); // Only one element in queue
+    app.input_queue = furi_message_queue_alloc(8, sizeof(AppEvent)); // Room for ticks between key events
+    app.tick_timer = furi_timer_alloc(tick_callback, FuriTimerTypePeriodic, &app);
+    app.render = malloc(2 * sizeof(RenderState)); // heap: too large for the app stack
+    app.render_front = 0;
+    app.render_mutex = furi_mutex_alloc(FuriMutexTypeNormal);
+    app.alert_timer = furi_timer_alloc(alert_timer_callback, FuriTimerTypeOnce, &app);
+    app.notifications = furi_record_open(RECORD_NOTIFICATION);
     // Callbacks
     view_port_draw_callback_set(app.view_port, draw_callback, &app);
     view_port_input_callback_set(app.view_port, input_callback, &app);
+    // Last session: the first frame can already show its city
+    AstroPreferences preferences;
+    bool has_preferences = load_preferences(&preferences);
+    if(has_preferences) {
+        apply_preferences_snapshot(&app, &preferences);
+    }
+    publish_render(&app); // the first frame
     // Initialize GUI
     app.gui = furi_record_open("gui");
     gui_add_view_port(app.gui, app.view_port, GuiLayerFullscreen);
 	// Load cities from CSV
-	app.csv_loaded = load_cities_from_csv(APP_DATA_PATH("european_cities.txt"));
+	app.csv_loaded = load_cities_from_csv(APP_DATA_PATH("cities.txt"));
 	count_cities_per_country();  // Update internal country array with counts
+	build_city_soa();
 	while(app.selected_country < country_count && 
 			european_countries[app.selected_country].city_count == 0) {
 		app.selected_country++;
@@ -516,19 +2028,64 @@ int32_t astro_main(void* p) {
 	FURI_LOG_I(TAG, "CSV loaded: %d, City count: %d", app.csv_loaded, city_count);
 	if(city_count > 0) {
 		FURI_LOG_I(TAG, "First city: code='%s' name='%s'", 
-				   cities[0].country_code, cities[0].name);
+				   city_at(0)->country_code, city_at(0)->name);
 	}
 	filter_cities_by_country(&app);
+	if(has_preferences) {
+		restore_selection(&app, &preferences);
+		restore_alerts(&app, &preferences);
+		if(preferences.screen == ScreenViews) {
+			app.current_screen = ScreenViews;
+		}
+	}
 	FURI_LOG_I(TAG, "After filter: %d cities", filtered_city_count);
+	refresh_sun_times(&app, true);
+	alerts_rebuild(&app);
+	publish_render(&app);
 
     // Input handling
+    AppEvent event;
     InputEvent input;
     uint8_t exit_loop = 0; // Flag to exit main loop
 
     FURI_LOG_I(TAG, "Start the main loop.");
     while(1) {
         furi_check(
-            furi_message_queue_get(app.input_queue, &input, FuriWaitForever) == FuriStatusOk);
+            furi_message_queue_get(app.input_queue, &event, FuriWaitForever) == FuriStatusOk);
+
+		if(app.alert_due) {
+			app.alert_due = false;
+			alerts_fire(&app);
+			if(app.current_screen == ScreenAlerts) {
+				publish_render(&app);
+			}
+		}
+		if(event.type == EventTypeAlert) {
+			continue;
+		}
+		if(event.type == EventTypeTick) {
+			if(app.current_screen == ScreenPosition) {
+				advance_sun_tracker(&app);
+				publish_render(&app);
+			} else if(app.current_screen == ScreenExport) {
+				if(!app.export_job || app.export_job->status != ExportRunning) {
+					furi_timer_stop(app.tick_timer);
+				}
+				publish_render(&app);
+			} else {
+				furi_timer_stop(app.tick_timer); // left the screen that needed it
+			}
+			continue;
+		}
+		input = event.input;
+
+		// Screens reached from the views menu handle their own keys
+		if(app.current_screen >= ScreenViews &&
+		   !(input.key == InputKeyBack && input.type == InputTypeLong)) {
+			handle_view_input(&app, &input);
+			publish_render(&app);
+			continue;
+		}
 			
 		// Handle button presses and holds based on selected screen
         switch(input.key) {
@@ -549,10 +2106,18 @@ int32_t astro_main(void* p) {
 							}
 						}
 						filter_cities_by_country(&app);
+						refresh_sun_times(&app, true);
 					} else if(app.current_menu == MenuCity && app.selected_city > 0) {
 						app.selected_city--;
+						refresh_sun_times(&app, true);
 					}
 				}
+				// Date steps also repeat while the key is held, to scrub through the year
+				if((input.type == InputTypePress || input.type == InputTypeRepeat) &&
+				   (app.current_screen == ScreenCities) && (app.current_menu == MenuDate)) {
+					step_date(&app.date, app.date_step, +1);
+					refresh_sun_times(&app, false);
+				}
 				break;
 			case InputKeyDown:
 				if((input.type == InputTypePress) && (app.current_screen == ScreenCities)) {
@@ -571,33 +2136,69 @@ int32_t astro_main(void* p) {
 							}
 						}
 						filter_cities_by_country(&app);
+						refresh_sun_times(&app, true);
 					} else if(app.current_menu == MenuCity && app.selected_city < filtered_city_count - 1) {
 						app.selected_city++;
+						refresh_sun_times(&app, true);
 					}
 				}
+				if((input.type == InputTypePress || input.type == InputTypeRepeat) &&
+				   (app.current_screen == ScreenCities) && (app.current_menu == MenuDate)) {
+					step_date(&app.date, app.date_step, -1);
+					refresh_sun_times(&app, false);
+				}
 				break;
 			case InputKeyLeft:
+				if ((input.type == InputTypePress) && (app.current_screen == ScreenCities)){
+					if(app.current_menu == MenuDate) {
+						// Skip the city menu if there's only one city
+						app.current_menu = (european_countries[app.selected_country].city_count > 1) ?
+							MenuCity : MenuCountry;
+					} else {
+						app.current_menu = MenuCountry;
+					}
+				}
+				break;
 			case InputKeyRight:
 				if ((input.type == InputTypePress) && (app.current_screen == ScreenCities)){
 					if(app.current_menu == MenuCountry) {
 						// Only switch to city menu if there's more than one city
-						if(european_countries[app.selected_country].city_count > 1) {
-							app.current_menu = MenuCity;
-						}
+						app.current_menu = (european_countries[app.selected_country].city_count > 1) ?
+							MenuCity : MenuDate;
 					} else {
-						app.current_menu = MenuCountry;
+						app.current_menu = MenuDate;
 					}
 				}
 				break;
 			case InputKeyOk:
-				if (input.type == InputTypePress){
+				// Act on the short press (key released) so that the same keystroke
+				// does not carry over into the next screen
+				if (input.type == InputTypeShort){
 					switch (app.current_screen) {
 						case ScreenSplash:
 							app.current_screen = ScreenCities;   
 						break;
+						case ScreenCities:
+							if(app.current_menu == MenuDate) {
+								// In the date menu a short OK cycles the step size
+								app.date_step = (app.date_step + 1) % DateStepCount;
+							} else {
+								app.current_screen = ScreenViews;
+							}
+						break;
 					}
 					break;
 				}
+				// A long OK in the date menu jumps back to today, elsewhere it
+				// adds or removes the city as a favourite for alerts
+				if((input.type == InputTypeLong) && (app.current_screen == ScreenCities)) {
+					if(app.current_menu == MenuDate) {
+						furi_hal_rtc_get_datetime(&app.date);
+						refresh_sun_times(&app, false);
+					} else {
+						toggle_favourite(&app);
+					}
+				}
 				break;
 			case InputKeyBack:
 			default:
@@ -609,14 +2210,25 @@ int32_t astro_main(void* p) {
 		// Exit main app loop if exit flag is set
         if(exit_loop) break; 
 		// Trigger screen redraw
-		view_port_update(app.view_port);
+		publish_render(&app);
     }
 
     // Cleanup: Free all allocated resources
+    export_stop(&app);
+    store_preferences(&app);
+    free_sd_cities();
+    furi_timer_stop(app.tick_timer);
+    furi_timer_free(app.tick_timer);
+    furi_timer_stop(app.alert_timer);
+    furi_timer_free(app.alert_timer);
+    furi_record_close(RECORD_NOTIFICATION);
     view_port_enabled_set(app.view_port, false);
     gui_remove_view_port(app.gui, app.view_port);
     furi_record_close("gui");
     view_port_free(app.view_port);
+    furi_mutex_free(app.render_mutex);
+    free(app.render);
+    furi_message_queue_free(app.input_queue);
 
     return 0;
 }
@@ -1,79 +1,53 @@
 #pragma once
 
 #include <furi.h>
-#include <furi_hal.h>
-#include <gui/gui.h>
-#include <input/input.h>
-#include <stdlib.h>
-#include <storage/storage.h>
-#include <dialogs/dialogs.h>
-#include <notification/notification.h>
-#include <notification/notification_messages.h>
-#include <toolbox/stream/stream.h>
-#include <toolbox/stream/file_stream.h>
+#include <stdbool.h>
+#include <stdint.h>
 
-#define TAG "CityInfoApp"
-#define PREFERENCES_FILE EXT_PATH("apps_data/city_info/preferences.txt")
-#define CITIES_FILE EXT_PATH("apps_data/city_info/cities.csv")
-#define LOGO_FILE EXT_PATH("apps_data/city_info/logo.png")
-#define SPLASH_FILE EXT_PATH("apps_data/city_info/splash.png")
-
-typedef enum {
-    EventTypeTick,
-    EventTypeKey,
-} EventType;
+// Preferences of the last session, restored at startup
+#define PREFERENCES_FILE APP_DATA_PATH("preferences.dat")
+#define PREFERENCES_MAGIC 0x4D // 'M'
+#define PREFERENCES_VERSION 3
 
+// Text lines of the cities screen. They only change with the city or the
+// date, so they are formatted once by update_city_text() instead of on
+// every frame.
 typedef struct {
-    EventType type;
-    InputEvent input;
-} AppEvent;
-
-typedef enum {
-    ScreenSplash,
-    ScreenMainMenu,
-    ScreenChooseCity,
-    ScreenCityInfo,
-} ScreenType;
-
+    char date[16];
+    char name[32];
+    uint8_t is_capital;
+    uint8_t is_favourite;
+    char coordinates[32];
+    char elevation[40];
+    char sunrise[8];
+    char sunset[8];
+    char daylength[8];
+} CityText;
+
+#define ALERT_MAX_FAVOURITES 4
+
+// Stored with saved_struct: the selection of the last session, plus a snapshot
+// of the cities screen for that city and 'snapshot_*' date. On a relaunch the
+// same day the snapshot is painted right away, before the cities are loaded.
 typedef struct {
-    char country_code[4];
-    char country_name[32];
-    char province[32];
+    char country_code[3];
     char city_name[32];
-    char description[64];
-    float utc_offset;
-    int longitude_deg;
-    int longitude_min;
-    int latitude_deg;
-    int latitude_min;
-} CityInfo;
-
-typedef enum {
-    MainMenuChooseCity,
-    MainMenuCityInfo,
-    MainMenuExit,
-    MainMenuCount
-} MainMenuIndex;
-
-typedef struct {
-    ScreenType current_screen;
-    int menu_index;
-    bool city_selected;
-    int country_index;
-    int city_index;
-    bool selector_focus; // true = city, false = country
-    CityInfo* cities;
-    int city_count;
-    CityInfo current_city;
-    FuriString* file_path;
-    FuriThread* thread;
-    bool loading;
-    bool initialized;
-} CityInfoApp;
-
-// Function declarations
-CityInfoApp* city_info_app_alloc();
-void city_info_app_free(CityInfoApp* app);
-void load_preferences(CityInfoApp* app);
-void save_preferences(CityInfoApp* app);
-int32_t city_info_app(void* p);
+    uint8_t screen;       // ScreenCities or ScreenViews
+    uint8_t view_index;
+    uint16_t snapshot_year;
+    uint8_t snapshot_month;
+    uint8_t snapshot_day;
+    CityText snapshot;
+    uint8_t alert_events;  // bit mask over SunEvent
+    struct {
+        char country_code[3];
+        char name[32];
+    } favourites[ALERT_MAX_FAVOURITES]; // empty name: unused slot
+    struct {
+        char country_code[3];
+        char name[32];
+    } home;                // zone of the Flipper clock, empty name: not chosen
+} AstroPreferences;
+
+bool load_preferences(AstroPreferences* preferences);
+bool save_preferences(const AstroPreferences* preferences);
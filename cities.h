@@ -0,0 +1,42 @@
+#ifndef CITIES_H
+#define CITIES_H
+
+#include <stdint.h>
+
+// ------------------------------------------------------------
+// STRUCT: City
+// ------------------------------------------------------------
+// One entry of the city list. The built-in entries live in flash
+// (cities_builtin.c, generated from data/european_cities.txt by
+// tools/gen_cities.py); entries from the optional file on the SD
+// card are appended in RAM.
+//
+typedef struct {
+    char country_code[3];
+    double utc_shift;   // standard time offset, DST comes from tzrules.c
+    const char *name;
+    double longitude;
+    double latitude;
+    int elevation_m;
+    uint8_t is_capital;
+} City;
+
+// ------------------------------------------------------------
+// STRUCT: CityRange
+// ------------------------------------------------------------
+// The built-in table is sorted by country; each country's cities
+// are builtin_cities[first .. first + count - 1].
+//
+typedef struct {
+    char country_code[3];
+    uint16_t first;
+    uint16_t count;
+} CityRange;
+
+extern const City builtin_cities[];
+extern const int builtin_city_count;
+
+extern const CityRange builtin_city_ranges[];
+extern const int builtin_city_range_count;
+
+#endif
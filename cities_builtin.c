@@ -0,0 +1,145 @@
+// Generated by tools/gen_cities.py from european_cities.txt. Do not edit.
+#include "cities.h"
+
+const City builtin_cities[] = {
+    { "AL", 1.0, "Tirana", 19.8172, 41.3317, 104, 1 },
+    { "AT", 1.0, "Vienna", 16.3728, 48.2092, 171, 1 },
+    { "BA", 1.0, "Sarajevo", 18.4214, 43.8608, 577, 1 },
+    { "BE", 1.0, "Brussels", 4.3676, 50.8371, 76, 1 },
+    { "BG", 2.0, "Sofia", 23.3238, 42.7105, 550, 1 },
+    { "BY", 3.0, "Minsk", 27.5766, 53.9678, 198, 1 },
+    { "CH", 1.0, "Bern", 7.4474, 46.9479, 542, 1 },
+    { "CZ", 1.0, "Prague", 14.4378, 50.0755, 200, 1 },
+    { "DE", 1.0, "Berlin", 13.405, 52.52, 34, 1 },
+    { "DE", 1.0, "Cologne", 6.9578, 50.9375, 53, 0 },
+    { "DE", 1.0, "Dortmund", 7.4653, 51.5136, 86, 0 },
+    { "DE", 1.0, "Duesseldorf", 6.7735, 51.2277, 38, 0 },
+    { "DE", 1.0, "Frankfurt am Main", 8.6821, 50.1109, 112, 0 },
+    { "DE", 1.0, "Hamburg", 9.9937, 53.5511, 8, 0 },
+    { "DE", 1.0, "Leipzig", 12.3747, 51.3397, 113, 0 },
+    { "DE", 1.0, "Munich", 11.582, 48.1351, 520, 0 },
+    { "DE", 1.0, "Stuttgart", 9.1829, 48.7758, 245, 0 },
+    { "DK", 1.0, "Copenhagen", 12.5681, 55.6763, 5, 1 },
+    { "EE", 2.0, "Tallinn", 24.7545, 59.4389, 37, 1 },
+    { "ES", 1.0, "Barcelona", 2.1734, 41.3851, 12, 0 },
+    { "ES", 1.0, "Bilbao", -2.9253, 43.263, 19, 0 },
+    { "ES", 0.0, "Las Palmas de Gran Canaria", -15.4362, 28.1248, 8, 0 },
+    { "ES", 1.0, "Madrid", -3.7038, 40.4168, 667, 1 },
+    { "ES", 1.0, "Malaga", -4.4214, 36.7213, 11, 0 },
+    { "ES", 1.0, "Murcia", -1.1307, 37.9922, 43, 0 },
+    { "ES", 1.0, "Palma de Mallorca", 2.6502, 39.5696, 13, 0 },
+    { "ES", 1.0, "Sevilla", -5.9845, 37.3891, 7, 0 },
+    { "ES", 1.0, "Valencia", -0.3763, 39.4699, 15, 0 },
+    { "ES", 1.0, "Zaragoza", -0.8773, 41.6488, 199, 0 },
+    { "FI", 2.0, "Helsinki", 24.9384, 60.1699, 25, 1 },
+    { "FR", 1.0, "Bordeaux", -0.5792, 44.8378, 8, 0 },
+    { "FR", 1.0, "Lille", 3.0573, 50.6292, 20, 0 },
+    { "FR", 1.0, "Lyon", 4.8357, 45.764, 173, 0 },
+    { "FR", 1.0, "Marseille", 5.3698, 43.2965, 15, 0 },
+    { "FR", 1.0, "Montpellier", 3.8767, 43.6108, 17, 0 },
+    { "FR", 1.0, "Nantes", -1.5534, 47.2184, 15, 0 },
+    { "FR", 1.0, "Nice", 7.262, 43.7102, 10, 0 },
+    { "FR", 1.0, "Paris", 2.3522, 48.8566, 35, 1 },
+    { "FR", 1.0, "Strasbourg", 7.7521, 48.5734, 142, 0 },
+    { "FR", 1.0, "Toulouse", 1.4442, 43.6047, 153, 0 },
+    { "GB", 0.0, "Birmingham", -1.8904, 52.4862, 140, 0 },
+    { "GB", 0.0, "Bristol", -2.5879, 51.4545, 11, 0 },
+    { "GB", 0.0, "Leeds", -1.5491, 53.8008, 62, 0 },
+    { "GB", 0.0, "Liverpool", -2.9916, 53.4084, 20, 0 },
+    { "GB", 0.0, "London", -0.1278, 51.5074, 11, 1 },
+    { "GB", 0.0, "Manchester", -2.2426, 53.4808, 38, 0 },
+    { "GB", 0.0, "Newcastle upon Tyne", -1.6178, 54.9783, 60, 0 },
+    { "GB", 0.0, "Nottingham", -1.1581, 52.9548, 65, 0 },
+    { "GB", 0.0, "Sheffield", -1.4701, 53.3811, 75, 0 },
+    { "GR", 2.0, "Athens", 23.7275, 37.9838, 70, 1 },
+    { "HR", 1.0, "Zagreb", 15.9785, 45.815, 130, 1 },
+    { "HU", 1.0, "Budapest", 19.0402, 47.4979, 96, 1 },
+    { "IE", 0.0, "Dublin", -6.2603, 53.3498, 20, 1 },
+    { "IS", 0.0, "Reykjavik", -21.8952, 64.1355, 21, 1 },
+    { "IT", 1.0, "Bari", 16.8719, 41.1171, 5, 0 },
+    { "IT", 1.0, "Bologna", 11.3426, 44.4949, 54, 0 },
+    { "IT", 1.0, "Florence", 11.2558, 43.7696, 50, 0 },
+    { "IT", 1.0, "Genoa", 8.9463, 44.4056, 20, 0 },
+    { "IT", 1.0, "Milan", 9.19, 45.4642, 120, 0 },
+    { "IT", 1.0, "Naples", 14.2681, 40.8518, 17, 0 },
+    { "IT", 1.0, "Palermo", 13.3615, 38.1157, 14, 0 },
+    { "IT", 1.0, "Rome", 12.4964, 41.9028, 21, 1 },
+    { "IT", 1.0, "Turin", 7.6869, 45.0703, 239, 0 },
+    { "LT", 2.0, "Vilnius", 25.2799, 54.6872, 156, 1 },
+    { "LU", 1.0, "Luxembourg", 6.1296, 49.6116, 334, 1 },
+    { "LV", 2.0, "Riga", 24.1052, 56.9496, 7, 1 },
+    { "MD", 2.0, "Chisinau", 28.8578, 47.0105, 83, 1 },
+    { "MK", 1.0, "Skopje", 21.4314, 41.9973, 240, 1 },
+    { "NL", 1.0, "Amsterdam", 4.8952, 52.3702, -2, 1 },
+    { "NO", 1.0, "Oslo", 10.7522, 59.9139, 23, 1 },
+    { "PL", 1.0, "Krakow", 19.945, 50.0647, 219, 0 },
+    { "PL", 1.0, "Warsaw", 21.0122, 52.2297, 100, 1 },
+    { "PT", 0.0, "Lisbon", -9.1393, 38.7223, 2, 1 },
+    { "RO", 2.0, "Bucharest", 26.1025, 44.4268, 70, 1 },
+    { "RS", 1.0, "Belgrade", 20.4612, 44.7866, 117, 1 },
+    { "RU", 3.0, "Moscow", 37.6173, 55.7558, 156, 1 },
+    { "RU", 3.0, "Saint Petersburg", 30.3351, 59.9343, 3, 0 },
+    { "SE", 1.0, "Goteborg", 11.9746, 57.7089, 12, 0 },
+    { "SE", 1.0, "Helsingborg", 12.6945, 56.0465, 5, 0 },
+    { "SE", 1.0, "Linkoping", 15.6214, 58.4108, 50, 0 },
+    { "SE", 1.0, "Malmo", 13.0038, 55.605, 12, 0 },
+    { "SE", 1.0, "Norrkoping", 16.1826, 58.5877, 10, 0 },
+    { "SE", 1.0, "Stockholm", 18.0686, 59.3293, 28, 1 },
+    { "SE", 1.0, "Uppsala", 17.6389, 59.8586, 15, 0 },
+    { "SE", 1.0, "Vasteras", 16.5448, 59.6099, 5, 0 },
+    { "SE", 1.0, "Orebro", 15.2134, 59.2753, 20, 0 },
+    { "SI", 1.0, "Ljubljana", 14.5058, 46.0569, 295, 1 },
+    { "SK", 1.0, "Bratislava", 17.1077, 48.1486, 140, 1 },
+    { "TR", 3.0, "Istanbul", 28.9744, 41.0082, 39, 0 },
+    { "UA", 2.0, "Dnipro", 35.0407, 48.4647, 60, 0 },
+    { "UA", 2.0, "Donetsk", 37.8028, 48.0159, 210, 0 },
+    { "UA", 2.0, "Kharkiv", 36.2304, 49.9808, 122, 0 },
+    { "UA", 2.0, "Kyiv", 30.5234, 50.4501, 179, 1 },
+    { "UA", 2.0, "Odesa", 30.7125, 46.4829, 50, 0 },
+    { "UA", 2.0, "Zaporizhzhia", 35.1396, 47.8388, 86, 0 },
+};
+
+const int builtin_city_count = 95;
+
+const CityRange builtin_city_ranges[] = {
+    { "AL", 0, 1 },
+    { "AT", 1, 1 },
+    { "BA", 2, 1 },
+    { "BE", 3, 1 },
+    { "BG", 4, 1 },
+    { "BY", 5, 1 },
+    { "CH", 6, 1 },
+    { "CZ", 7, 1 },
+    { "DE", 8, 9 },
+    { "DK", 17, 1 },
+    { "EE", 18, 1 },
+    { "ES", 19, 10 },
+    { "FI", 29, 1 },
+    { "FR", 30, 10 },
+    { "GB", 40, 9 },
+    { "GR", 49, 1 },
+    { "HR", 50, 1 },
+    { "HU", 51, 1 },
+    { "IE", 52, 1 },
+    { "IS", 53, 1 },
+    { "IT", 54, 9 },
+    { "LT", 63, 1 },
+    { "LU", 64, 1 },
+    { "LV", 65, 1 },
+    { "MD", 66, 1 },
+    { "MK", 67, 1 },
+    { "NL", 68, 1 },
+    { "NO", 69, 1 },
+    { "PL", 70, 2 },
+    { "PT", 72, 1 },
+    { "RO", 73, 1 },
+    { "RS", 74, 1 },
+    { "RU", 75, 2 },
+    { "SE", 77, 9 },
+    { "SI", 86, 1 },
+    { "SK", 87, 1 },
+    { "TR", 88, 1 },
+    { "UA", 89, 6 },
+};
+
+const int builtin_city_range_count = 38;
@@ -1,46 +1,9 @@
 #include "suntimes.h"
 #include <math.h>
+#include <stdint.h>
 #include <string.h>
 
-#define PI 3.14159265358979323846
-
-// ------------------------------------------------------------
-// STRUCT: SunTimes
-// ------------------------------------------------------------
-// Contains all relevant solar times for a specific date and location.
-// All times are expressed in hour + minute integer fields.
-//
-// Includes Civil, Nautical, and Astronomical dawn/dusk times,
-// plus sunrise, sunset, and day length.
-//
-// If the sun does not rise or set (polar day/night), the times are
-// set to -1 and 'comment' contains the explanation.
-//
-typedef struct {
-    // Civil dawn/dusk (sun at -6 degrees)
-    int civil_dawn_hour, civil_dawn_minute;
-    int civil_dusk_hour, civil_dusk_minute;
-
-    // Nautical dawn/dusk (sun at -12 degrees)
-    int nautical_dawn_hour, nautical_dawn_minute;
-    int nautical_dusk_hour, nautical_dusk_minute;
-
-    // Astronomical dawn/dusk (sun at -18 degrees)
-    int astronomical_dawn_hour, astronomical_dawn_minute;
-    int astronomical_dusk_hour, astronomical_dusk_minute;
-
-    // Sunrise & sunset times
-    int sunrise_hour, sunrise_minute;
-    int sunset_hour, sunset_minute;
-
-    // Day length
-    int daylength_hour, daylength_minute;
-
-    // Comment for errors or special conditions
-    char comment[256];
-
-} SunTimes;
-
+#define PI 3.14159265358979323846L
 
 // ------------------------------------------------------------
 // HELPER: Check Gregorian reform (1582)
@@ -78,6 +41,24 @@ int is_valid_date(int y, int m, int d) {
     return 1;
 }
 
+// ------------------------------------------------------------
+// julian_day(): Julian Day of a date and UT (Meeus, ch. 7).
+// Julian calendar before the 1582 reform, Gregorian after.
+// ------------------------------------------------------------
+double julian_day(int year, int month, int day, double ut_hours) {
+    if (month <= 2) {
+        year -= 1;
+        month += 12;
+    }
+    int B = 0;
+    if (year > 1582 || (year == 1582 && (month > 10 || (month == 10 && day >= 15)))) {
+        int A = year / 100;
+        B = 2 - A + A / 4;
+    }
+    return floor(365.25L * (year + 4716)) + floor(30.6001L * (month + 1))
+           + day + B - 1524.5L + ut_hours / 24.0L;
+}
+
 // ------------------------------------------------------------
 // HELPER: Convert hour float to (hour, minute)
 // ------------------------------------------------------------
@@ -87,42 +68,69 @@ void split_time(double hours, int *h, int *m) {
         return;
     }
     *h = (int)hours;
-    *m = (int)round((hours - *h) * 60.0);
+    *m = (int)round((hours - *h) * 60.0L);
     if (*m == 60) { *m = 0; (*h)++; }
 }
 
+
 // ------------------------------------------------------------
-// HELPER: Compute solar event given depression angle
-// Uses simplified NOAA algorithm
+// Event table: depression angle and rising/setting flag for
+// every SunEvent, in enum order.
 // ------------------------------------------------------------
-double compute_event_time(int year, int month, int day,
-                          double latitude_deg, double longitude_deg,
-                          double tz_offset, double depression_deg,
-                          int is_sunrise) {
-    // Convert degrees to radians
-    double lat = latitude_deg * PI / 180.0;
-
-    // Days since J2000.0 (approx)
-    int N1 = floor(275 * month / 9);
-    int N2 = floor((month + 9) / 12);
-    int N3 = (1 + floor((year - 4 * floor(year / 4) + 2) / 3));
-    int N = N1 - (N2 * N3) + day - 30;
+static const struct {
+    double depression_deg;
+    int is_sunrise;
+} sun_events[SunEventCount] = {
+    [SunEventAstronomicalDawn] = { -18.0L,  1 },
+    [SunEventNauticalDawn]     = { -12.0L,  1 },
+    [SunEventCivilDawn]        = {  -6.0L,  1 },
+    [SunEventSunrise]          = { -0.833L, 1 },  // includes refraction + solar radius
+    [SunEventSunset]           = { -0.833L, 0 },
+    [SunEventCivilDusk]        = {  -6.0L,  0 },
+    [SunEventNauticalDusk]     = { -12.0L,  0 },
+    [SunEventAstronomicalDusk] = { -18.0L,  0 },
+};
+
+// Maximum solver passes per event. A cold start needs two, a warm
+// start from the previous day one.
+#define SUN_MAX_ITERATIONS 4
+
+// A pass is accepted once the event moved less than this against
+// the time the sun position was evaluated for. Six minutes of solar
+// motion shift the event by well under a second.
+#define SUN_SEED_TOLERANCE_HOURS 0.1L
 
-    double lng_hour = longitude_deg / 15.0;
+// ------------------------------------------------------------
+// HELPER: Day of year, from the same Julian Day code as the moon
+// ------------------------------------------------------------
+static double day_of_year(int year, int month, int day) {
+    return julian_day(year, month, day, 0) - julian_day(year, 1, 1, 0) + 1;
+}
 
-    double t = N + ((is_sunrise ? 6.0 : 18.0) - lng_hour) / 24;
+// ------------------------------------------------------------
+// HELPER: Greenwich mean sidereal time in degrees (Meeus 12.4),
+// not reduced to 0..360
+// ------------------------------------------------------------
+static double greenwich_sidereal_deg(double jd) {
+    return 280.46061837L + 360.98564736629L * (jd - 2451545.0L);
+}
 
+// ------------------------------------------------------------
+// HELPER: Sun declination and right ascension at day number t
+// (day of year plus UT fraction), simplified NOAA algorithm.
+// ------------------------------------------------------------
+static void sun_position(double t, double *sinDec, double *cosDec, double *ra_hours) {
     // Sun mean anomaly
-    double M = (0.9856 * t) - 3.289;
+    double M = (0.9856L * t) - 3.289L;
 
     // Sun true longitude
-    double L = M + 1.916 * sin(M * PI/180) +
-                    0.020 * sin(2 * M * PI/180) + 282.634;
-    if (L > 360) L -= 360;
-    if (L < 0)   L += 360;
+    double L = M + 1.916L * sin(M * PI/180) +
+                    0.020L * sin(2 * M * PI/180) + 282.634L;
+    L = fmod(L, 360);
+    if (L < 0) L += 360;
 
     // Sun right ascension
-    double RA = atan(0.91764 * tan(L * PI/180)) * 180/PI;
+    double RA = atan(0.91764L * tan(L * PI/180)) * 180/PI;
     if (RA < 0) RA += 360;
     if (RA >= 360) RA -= 360;
 
@@ -131,46 +139,115 @@ double compute_event_time(int year, int month, int day,
     int RA_quadrant = (int)(floor(RA/90)) * 90;
     RA = RA + (L_quadrant - RA_quadrant);
 
-    RA /= 15.0;
+    *ra_hours = RA / 15.0L;
 
     // Sun declination
-    double sinDec = 0.39782 * sin(L * PI/180);
-    double cosDec = cos(asin(sinDec));
+    *sinDec = 0.39782L * sin(L * PI/180);
+    *cosDec = cos(asin(*sinDec));
+}
+
+// ------------------------------------------------------------
+// HELPER: Compute solar event given depression angle
+// Uses simplified NOAA algorithm, iterated to convergence.
+//
+// 'seed_ut' is the first guess for the event in UT hours, or
+// SUN_NO_SEED for a cold start from 06:00/18:00 local mean time.
+// On success it receives the solution (UT hours, not wrapped into
+// 0..24, so it stays on the right day for the next seed) and the
+// local time is returned. Returns -1 if the event does not happen.
+// ------------------------------------------------------------
+double compute_event_time(int year, int month, int day,
+                          double latitude_deg, double longitude_deg,
+                          double tz_offset, double depression_deg,
+                          int is_sunrise, double *seed_ut) {
+    // Convert degrees to radians
+    double lat = latitude_deg * PI / 180.0L;
+    double cos_zenith = cos((90 - depression_deg) * PI/180);  // altitude -> zenith distance
+
+    double N = day_of_year(year, month, day);
+    double lng_hour = longitude_deg / 15.0L;
 
-    // Sun local hour angle
-    double cosH = (cos((90 + depression_deg) * PI/180) -
-                   (sinDec * sin(lat))) / (cosDec * cos(lat));
+    double guess = (*seed_ut != SUN_NO_SEED) ? *seed_ut
+                                             : (is_sunrise ? 6.0L : 18.0L) - lng_hour;
 
-    if (cosH > 1) return -1;   // Sun never rises (polar night)
-    if (cosH < -1) return -1;  // Sun never sets   (midnight sun)
+    for (int pass = 0; pass < SUN_MAX_ITERATIONS; pass++) {
+        double t = N + guess / 24;
 
-    double H = (is_sunrise ? 360 - acos(cosH) * 180/PI
-                           : acos(cosH) * 180/PI) / 15.0;
+        double sinDec, cosDec, RA;
+        sun_position(t, &sinDec, &cosDec, &RA);
 
-    // Local mean time
-    double T = H + RA - (0.06571 * t) - 6.622;
+        // Sun local hour angle
+        double cosH = (cos_zenith - (sinDec * sin(lat))) / (cosDec * cos(lat));
 
-    // Convert to UTC, then add time zone
-    double UT = T - lng_hour;
-    if (UT < 0) UT += 24;
-    if (UT >= 24) UT -= 24;
+        if (cosH > 1) return -1;   // Sun never rises (polar night)
+        if (cosH < -1) return -1;  // Sun never sets   (midnight sun)
 
-    double localT = UT + tz_offset;
-    if (localT < 0) localT += 24;
-    if (localT >= 24) localT -= 24;
+        double H = (is_sunrise ? 360 - acos(cosH) * 180/PI
+                               : acos(cosH) * 180/PI) / 15.0L;
+
+        // Local mean time
+        double T = H + RA - (0.06571L * t) - 6.622L;
+
+        // Convert to UTC, kept within half a day of the guess
+        double UT = T - lng_hour;
+        UT -= 24 * floor((UT - guess + 12) / 24);
+
+        double delta = fabs(UT - guess);
+        guess = UT;
+        if (delta < SUN_SEED_TOLERANCE_HOURS) break;
+    }
+    *seed_ut = guess;
+
+    // Add time zone and wrap into the local day
+    double localT = guess + tz_offset;
+    localT -= 24 * floor(localT / 24);
 
     return localT;
 }
 
+// ------------------------------------------------------------
+// HELPER: Altitude of the sun at local noon (upper culmination)
+// and local midnight (lower culmination), with the declination
+// of local noon: 90 - |lat - dec| and |lat + dec| - 90.
+// ------------------------------------------------------------
+static void sun_culminations(int year, int month, int day,
+                             double latitude_deg, double longitude_deg,
+                             double *noon_alt, double *midnight_alt) {
+    double t = day_of_year(year, month, day) + (12 - longitude_deg / 15.0L) / 24;
+    double sinDec, cosDec, RA;
+    sun_position(t, &sinDec, &cosDec, &RA);
+    double dec = asin(sinDec) * 180/PI;
+
+    *noon_alt = 90 - fabs(latitude_deg - dec);
+    *midnight_alt = fabs(latitude_deg + dec) - 90;
+}
+
+// ------------------------------------------------------------
+// HELPER: Does the sun cross 'altitude' between the extremes?
+// ------------------------------------------------------------
+static SunEventStatus sun_event_status(double altitude, double noon_alt, double midnight_alt) {
+    if (midnight_alt >= altitude) return SunEventAlwaysAbove;
+    if (noon_alt <= altitude) return SunEventAlwaysBelow;
+    return SunEventOccurs;
+}
 
 // ------------------------------------------------------------
-// MAIN FUNCTION: sun()
+// sun_state_reset(): forget all seeds (e.g. new location)
 // ------------------------------------------------------------
-SunTimes sun(int year, int month, int day,
-             int lat_degree, int lat_minute,
-             int lon_degree, int lon_minute,
-             int height_meters,
-             float time_zone_offset_to_utc_in_hours)
+void sun_state_reset(SunState* state) {
+    for (int i = 0; i < SunEventCount; i++) {
+        state->seed_ut[i] = SUN_NO_SEED;
+    }
+}
+
+// ------------------------------------------------------------
+// sun_step(): like sun(), with decimal degrees and a warm-start
+// state carried over from the previously computed date.
+// ------------------------------------------------------------
+SunTimes sun_step(SunState* state,
+                  int year, int month, int day,
+                  double latitude_deg, double longitude_deg,
+                  float time_zone_offset_to_utc_in_hours)
 {
     SunTimes result;
     memset(&result, -1, sizeof(result));
@@ -183,42 +260,59 @@ SunTimes sun(int year, int month, int day,
         return result;
     }
 
-    // Convert lat/lon to decimal degrees
-    double lat = lat_degree + lat_minute / 60.0;
-    double lon = lon_degree + lon_minute / 60.0;
-
-    // Twilight angles
-    double civil_angle        = -6.0;
-    double nautical_angle     = -12.0;
-    double astronomical_angle = -18.0;
-    double sunrise_angle      = -0.833;   // includes refraction + solar radius
-
-    // Compute all events
-    double civil_dawn  = compute_event_time(year,month,day,lat,lon,time_zone_offset_to_utc_in_hours,civil_angle,1);
-    double civil_dusk  = compute_event_time(year,month,day,lat,lon,time_zone_offset_to_utc_in_hours,civil_angle,0);
-    double nautical_dawn  = compute_event_time(year,month,day,lat,lon,time_zone_offset_to_utc_in_hours,nautical_angle,1);
-    double nautical_dusk  = compute_event_time(year,month,day,lat,lon,time_zone_offset_to_utc_in_hours,nautical_angle,0);
-    double astronomical_dawn  = compute_event_time(year,month,day,lat,lon,time_zone_offset_to_utc_in_hours,astronomical_angle,1);
-    double astronomical_dusk  = compute_event_time(year,month,day,lat,lon,time_zone_offset_to_utc_in_hours,astronomical_angle,0);
-
-    double sunrise = compute_event_time(year,month,day,lat,lon,time_zone_offset_to_utc_in_hours,sunrise_angle,1);
-    double sunset  = compute_event_time(year,month,day,lat,lon,time_zone_offset_to_utc_in_hours,sunrise_angle,0);
-
-    // Polar cases
-    if (sunrise < 0 && sunset < 0) {
-        strcpy(result.comment, "Polar day or polar night: sun does not rise or set.");
-        return result;
+    // Classify first, so that events which cannot happen today (e.g.
+    // nautical twilight in a Nordic summer) are not solved at all
+    double noon_alt, midnight_alt;
+    sun_culminations(year, month, day, latitude_deg, longitude_deg, &noon_alt, &midnight_alt);
+
+    // Compute all events; a failed event keeps its old seed
+    double t[SunEventCount];
+    for (int i = 0; i < SunEventCount; i++) {
+        result.status[i] = sun_event_status(sun_events[i].depression_deg, noon_alt, midnight_alt);
+        if (result.status[i] != SunEventOccurs) {
+            t[i] = -1;
+            continue;
+        }
+        double seed = state->seed_ut[i];
+        t[i] = compute_event_time(year, month, day, latitude_deg, longitude_deg,
+                                  time_zone_offset_to_utc_in_hours,
+                                  sun_events[i].depression_deg,
+                                  sun_events[i].is_sunrise, &seed);
+        if (t[i] >= 0) {
+            state->seed_ut[i] = seed;
+        } else {
+            // Grazing the altitude within minutes of noon or midnight
+            result.status[i] = (noon_alt - sun_events[i].depression_deg <
+                                sun_events[i].depression_deg - midnight_alt)
+                               ? SunEventAlwaysBelow : SunEventAlwaysAbove;
+        }
+    }
+
+    double sunrise = t[SunEventSunrise];
+    double sunset  = t[SunEventSunset];
+
+    // Polar and high-latitude cases
+    if (result.status[SunEventSunrise] == SunEventAlwaysAbove) {
+        strcpy(result.comment, "Polar day: sun never sets.");
+    } else if (result.status[SunEventSunrise] == SunEventAlwaysBelow) {
+        strcpy(result.comment, result.status[SunEventCivilDawn] == SunEventAlwaysBelow
+               ? "Polar night: sun never rises, no civil twilight."
+               : "Polar night: sun never rises.");
+    } else if (result.status[SunEventNauticalDawn] == SunEventAlwaysAbove) {
+        strcpy(result.comment, "White night: sun never below -12 deg, no nautical or astronomical dusk.");
+    } else if (result.status[SunEventAstronomicalDawn] == SunEventAlwaysAbove) {
+        strcpy(result.comment, "Sun never below -18 deg: no astronomical night.");
     }
 
     // Split times into hour/minute
-    split_time(civil_dawn, &result.civil_dawn_hour, &result.civil_dawn_minute);
-    split_time(civil_dusk, &result.civil_dusk_hour, &result.civil_dusk_minute);
+    split_time(t[SunEventCivilDawn], &result.civil_dawn_hour, &result.civil_dawn_minute);
+    split_time(t[SunEventCivilDusk], &result.civil_dusk_hour, &result.civil_dusk_minute);
 
-    split_time(nautical_dawn, &result.nautical_dawn_hour, &result.nautical_dawn_minute);
-    split_time(nautical_dusk, &result.nautical_dusk_hour, &result.nautical_dusk_minute);
+    split_time(t[SunEventNauticalDawn], &result.nautical_dawn_hour, &result.nautical_dawn_minute);
+    split_time(t[SunEventNauticalDusk], &result.nautical_dusk_hour, &result.nautical_dusk_minute);
 
-    split_time(astronomical_dawn, &result.astronomical_dawn_hour, &result.astronomical_dawn_minute);
-    split_time(astronomical_dusk, &result.astronomical_dusk_hour, &result.astronomical_dusk_minute);
+    split_time(t[SunEventAstronomicalDawn], &result.astronomical_dawn_hour, &result.astronomical_dawn_minute);
+    split_time(t[SunEventAstronomicalDusk], &result.astronomical_dusk_hour, &result.astronomical_dusk_minute);
 
     split_time(sunrise, &result.sunrise_hour, &result.sunrise_minute);
     split_time(sunset,  &result.sunset_hour,  &result.sunset_minute);
@@ -228,8 +322,421 @@ SunTimes sun(int year, int month, int day,
         double dl = sunset - sunrise;
         if (dl < 0) dl += 24;
         split_time(dl, &result.daylength_hour, &result.daylength_minute);
+    } else if (result.status[SunEventSunrise] != SunEventOccurs) {
+        result.daylength_hour = (result.status[SunEventSunrise] == SunEventAlwaysAbove) ? 24 : 0;
+        result.daylength_minute = 0;
     }
 
     return result;
 }
 
+
+// ------------------------------------------------------------
+// sun_day_terms(): evaluate the date-dependent part once.
+// 'ut_hours' should be near the events of interest, e.g. 06:00
+// local mean time for sunrises; being a few hours off costs about
+// a minute of accuracy, which is fine for comparing cities.
+// ------------------------------------------------------------
+void sun_day_terms(SunDayTerms* terms, int year, int month, int day, double ut_hours) {
+    double t = day_of_year(year, month, day) + ut_hours / 24;
+    double sinDec, cosDec, RA;
+    sun_position(t, &sinDec, &cosDec, &RA);
+
+    terms->sin_dec = sinDec;
+    terms->cos_dec = cosDec;
+    terms->sidereal_offset = RA - (0.06571L * t) - 6.622L;
+    terms->ut_hours = ut_hours;
+}
+
+// ------------------------------------------------------------
+// sun_batch_event(): one event for many locations at once.
+// Inputs are structure-of-arrays (sine/cosine of latitude and
+// longitude in hours). Writes the UT of the event (within half a
+// day of terms->ut_hours) or NAN where it does not happen: acosf()
+// of an out-of-range cosH yields NAN, so the loop has no branches.
+// ------------------------------------------------------------
+void sun_batch_event(const SunDayTerms* terms, SunEvent event,
+                     const float* sin_lat, const float* cos_lat,
+                     const float* lng_hour, int count, float* event_ut) {
+    const float cos_zenith = cosf((90 - sun_events[event].depression_deg) * PI/180);
+    const float sign = sun_events[event].is_sunrise ? -1.0f : 1.0f;
+    const float rad_to_hours = (float)(12 / PI);
+    const float center = terms->ut_hours;
+
+    for (int i = 0; i < count; i++) {
+        float cosH = (cos_zenith - terms->sin_dec * sin_lat[i]) /
+                     (terms->cos_dec * cos_lat[i]);
+        float UT = sign * acosf(cosH) * rad_to_hours + terms->sidereal_offset - lng_hour[i];
+        event_ut[i] = UT - 24 * floorf((UT - center + 12) / 24);
+    }
+}
+
+// ------------------------------------------------------------
+// sun_tracker_sync(): full evaluation for a UT instant
+// ------------------------------------------------------------
+void sun_tracker_sync(SunTracker *tracker, int year, int month, int day, double ut_hours,
+                      double latitude_deg, double longitude_deg) {
+    double sinDec, cosDec, RA;
+    sun_position(day_of_year(year, month, day) + ut_hours / 24, &sinDec, &cosDec, &RA);
+
+    // Greenwich mean sidereal time (degrees), then local hour angle
+    double gmst = greenwich_sidereal_deg(julian_day(year, month, day, ut_hours));
+    double H = (gmst + longitude_deg - RA * 15) * PI/180;
+
+    // One second of the sun's hour angle: the sidereal rotation less the
+    // sun's eastward drift in right ascension, i.e. 360 degrees a solar day
+    double step = 360.0L / 86400 * PI/180;
+
+    tracker->sin_lat = sin(latitude_deg * PI/180);
+    tracker->cos_lat = cos(latitude_deg * PI/180);
+    tracker->sin_dec = sinDec;
+    tracker->cos_dec = cosDec;
+    tracker->sin_h = sin(H);
+    tracker->cos_h = cos(H);
+    tracker->sin_step = sin(step);
+    tracker->cos_step = cos(step);
+    tracker->seconds_since_sync = 0;
+}
+
+// ------------------------------------------------------------
+// sun_tracker_advance(): move the hour angle on by some seconds.
+// Returns 1 when a resync is due (periodically, or if the jump is
+// too large to be worth rotating step by step).
+// ------------------------------------------------------------
+int sun_tracker_advance(SunTracker *tracker, int seconds) {
+    if (seconds < 0 || seconds > 60) return 1;
+    for (int i = 0; i < seconds; i++) {
+        double s = tracker->sin_h * tracker->cos_step + tracker->cos_h * tracker->sin_step;
+        double c = tracker->cos_h * tracker->cos_step - tracker->sin_h * tracker->sin_step;
+        tracker->sin_h = s;
+        tracker->cos_h = c;
+    }
+    tracker->seconds_since_sync += seconds;
+    return tracker->seconds_since_sync >= SUN_TRACKER_RESYNC_SECONDS;
+}
+
+// ------------------------------------------------------------
+// sun_tracker_position(): azimuth (from north, clockwise) and
+// elevation, both in degrees, without refraction
+// ------------------------------------------------------------
+void sun_tracker_position(const SunTracker *tracker, double *azimuth_deg, double *elevation_deg) {
+    double sin_alt = tracker->sin_lat * tracker->sin_dec +
+                     tracker->cos_lat * tracker->cos_dec * tracker->cos_h;
+    *elevation_deg = asin(sin_alt) * 180/PI;
+
+    double az = atan2(-tracker->cos_dec * tracker->sin_h,
+                      tracker->sin_dec * tracker->cos_lat -
+                      tracker->cos_dec * tracker->cos_h * tracker->sin_lat) * 180/PI;
+    *azimuth_deg = (az < 0) ? az + 360 : az;
+}
+
+// ------------------------------------------------------------
+// MAIN FUNCTION: sun()
+// ------------------------------------------------------------
+SunTimes sun(int year, int month, int day,
+             int lat_degree, int lat_minute,
+             int lon_degree, int lon_minute,
+             int height_meters,
+             float time_zone_offset_to_utc_in_hours)
+{
+    (void)height_meters; // not used by the simplified algorithm yet
+
+    // Convert lat/lon to decimal degrees
+    double lat = lat_degree + lat_minute / 60.0L;
+    double lon = lon_degree + lon_minute / 60.0L;
+
+    // One-off query: cold start for every event
+    SunState state;
+    sun_state_reset(&state);
+
+    return sun_step(&state, year, month, day, lat, lon,
+                    time_zone_offset_to_utc_in_hours);
+}
+
+
+// ------------------------------------------------------------
+// horizon_day_init(): sample the altitude over one local day
+// ------------------------------------------------------------
+void horizon_day_init(HorizonDay *day, AltitudeFn altitude, void *ctx, double start_ut) {
+    day->altitude = altitude;
+    day->ctx = ctx;
+    day->start_ut = start_ut;
+    for (int i = 0; i < HORIZON_SAMPLES; i++) {
+        day->alt[i] = altitude(start_ut + i, ctx);
+    }
+}
+
+// ------------------------------------------------------------
+// horizon_crossing(): first rising (or setting) crossing of the
+// threshold altitude. Returns local hours since midnight, or -1
+// if there is none that day.
+// ------------------------------------------------------------
+double horizon_crossing(const HorizonDay *day, double threshold_deg, int rising) {
+    for (int i = 0; i + 1 < HORIZON_SAMPLES; i++) {
+        double f0 = day->alt[i] - threshold_deg;
+        double f1 = day->alt[i + 1] - threshold_deg;
+        int crosses = rising ? (f0 < 0 && f1 >= 0) : (f0 >= 0 && f1 < 0);
+        if (!crosses) continue;
+
+        // Regula falsi (Illinois variant) inside the bracket
+        double a = i, b = i + 1;
+        double x = a - f0 * (b - a) / (f1 - f0);
+        for (int step = 0; step < HORIZON_REFINE_STEPS; step++) {
+            double fx = day->altitude(day->start_ut + x, day->ctx) - threshold_deg;
+            if (fabs(fx) < 0.002L) break;   // a few seconds of time
+            if ((fx < 0) == (f0 < 0)) {
+                a = x; f0 = fx; f1 /= 2;
+            } else {
+                b = x; f1 = fx; f0 /= 2;
+            }
+            x = a - f0 * (b - a) / (f1 - f0);
+        }
+        return x;
+    }
+    return -1;
+}
+
+// ------------------------------------------------------------
+// HELPER: Sun altitude in degrees (no refraction) at a UT, with
+// the same simplified NOAA model as compute_event_time(), so that
+// sun_altitude_crossing(day, -0.833, 1) agrees with sunrise.
+// ------------------------------------------------------------
+static double sun_altitude(double ut_hours, void *ctx) {
+    const SunObserver *obs = ctx;
+    double t = obs->day_number + ut_hours / 24;
+    double sinDec, cosDec, RA;
+    sun_position(t, &sinDec, &cosDec, &RA);
+
+    // Inverse of the local mean time formula of compute_event_time()
+    double H = (ut_hours + obs->lng_hour - RA + (0.06571L * t) + 6.622L) * 15 * PI/180;
+    return asin(obs->sin_lat * sinDec + obs->cos_lat * cosDec * cos(H)) * 180/PI;
+}
+
+// ------------------------------------------------------------
+// sun_day_init(): sample the sun altitude over one local day
+// ------------------------------------------------------------
+void sun_day_init(SunDay *day, int year, int month, int day_of_month,
+                  double latitude_deg, double longitude_deg,
+                  float time_zone_offset_to_utc_in_hours) {
+    day->observer.day_number = day_of_year(year, month, day_of_month);
+    day->observer.sin_lat = sin(latitude_deg * PI/180);
+    day->observer.cos_lat = cos(latitude_deg * PI/180);
+    day->observer.lng_hour = longitude_deg / 15.0L;
+    horizon_day_init(&day->samples, sun_altitude, &day->observer,
+                     -time_zone_offset_to_utc_in_hours);
+}
+
+// ------------------------------------------------------------
+// sun_altitude_crossing(): local time at which the sun rises
+// (or sets) through the given altitude, or -1
+// ------------------------------------------------------------
+double sun_altitude_crossing(const SunDay *day, double altitude_deg, int rising) {
+    return horizon_crossing(&day->samples, altitude_deg, rising);
+}
+
+// ------------------------------------------------------------
+// MAIN FUNCTION: sun_light()
+// ------------------------------------------------------------
+// Six crossings from one set of HORIZON_SAMPLES evaluations.
+//
+SunLight sun_light(int year, int month, int day,
+                   double latitude_deg, double longitude_deg,
+                   float time_zone_offset_to_utc_in_hours)
+{
+    SunLight result = {{-1, -1}, {-1, -1}, {-1, -1}, {-1, -1}};
+    if (!is_valid_date(year, month, day)) return result;
+
+    SunDay samples;
+    sun_day_init(&samples, year, month, day, latitude_deg, longitude_deg,
+                 time_zone_offset_to_utc_in_hours);
+
+    result.blue_morning.start = sun_altitude_crossing(&samples, SUN_BLUE_HOUR_LOW_DEG, 1);
+    result.blue_morning.end = sun_altitude_crossing(&samples, SUN_BLUE_HOUR_HIGH_DEG, 1);
+    result.golden_morning.start = result.blue_morning.end;
+    result.golden_morning.end = sun_altitude_crossing(&samples, SUN_GOLDEN_HOUR_HIGH_DEG, 1);
+    result.golden_evening.start = sun_altitude_crossing(&samples, SUN_GOLDEN_HOUR_HIGH_DEG, 0);
+    result.golden_evening.end = sun_altitude_crossing(&samples, SUN_BLUE_HOUR_HIGH_DEG, 0);
+    result.blue_evening.start = result.golden_evening.end;
+    result.blue_evening.end = sun_altitude_crossing(&samples, SUN_BLUE_HOUR_LOW_DEG, 0);
+    return result;
+}
+
+// ------------------------------------------------------------
+// MOON: truncated ELP-2000/82 series (Meeus, ch. 47)
+// ------------------------------------------------------------
+// Only the largest terms are kept: about 0.02 degrees in longitude
+// and 0.01 degrees in latitude, i.e. well below a minute of
+// moonrise/moonset time. Arguments are multiples of D, M, M', F;
+// longitude in 1e-6 degrees, distance in 1e-3 km.
+//
+static const struct {
+    signed char D, M, Mp, F;
+    int32_t l, r;
+} moon_lr_terms[] = {
+    { 0,  0,  1,  0,  6288774, -20905355 },
+    { 2,  0, -1,  0,  1274027,  -3699111 },
+    { 2,  0,  0,  0,   658314,  -2955968 },
+    { 0,  0,  2,  0,   213618,   -569925 },
+    { 0,  1,  0,  0,  -185116,     48888 },
+    { 0,  0,  0,  2,  -114332,     -3149 },
+    { 2,  0, -2,  0,    58793,    246158 },
+    { 2, -1, -1,  0,    57066,   -152138 },
+    { 2,  0,  1,  0,    53322,   -170733 },
+    { 2, -1,  0,  0,    45758,   -204586 },
+    { 0,  1, -1,  0,   -40923,   -129620 },
+    { 1,  0,  0,  0,   -34720,    108743 },
+    { 0,  1,  1,  0,   -30383,    104755 },
+    { 2,  0,  0, -2,    15327,     10321 },
+    { 0,  0,  1,  2,   -12528,         0 },
+    { 0,  0,  1, -2,    10980,     79661 },
+    { 4,  0, -1,  0,    10675,    -34782 },
+    { 0,  0,  3,  0,    10034,    -23210 },
+    { 4,  0, -2,  0,     8548,    -21636 },
+    { 2,  1, -1,  0,    -7888,     24208 },
+    { 2,  1,  0,  0,    -6766,     30824 },
+    { 1,  0, -1,  0,    -5163,     -8379 },
+    { 1,  1,  0,  0,     4987,    -16675 },
+    { 2, -1,  1,  0,     4036,    -12831 },
+};
+
+// Latitude terms, 1e-6 degrees
+static const struct {
+    signed char D, M, Mp, F;
+    int32_t b;
+} moon_b_terms[] = {
+    { 0,  0,  0,  1, 5128122 },
+    { 0,  0,  1,  1,  280602 },
+    { 0,  0,  1, -1,  277693 },
+    { 2,  0,  0, -1,  173237 },
+    { 2,  0, -1,  1,   55413 },
+    { 2,  0, -1, -1,   46271 },
+    { 2,  0,  0,  1,   32573 },
+    { 0,  0,  2,  1,   17198 },
+    { 2,  0,  1, -1,    9266 },
+    { 0,  0,  2, -1,    8822 },
+    { 2, -1,  0, -1,    8216 },
+    { 2,  0, -2, -1,    4324 },
+    { 2,  0,  1,  1,    4200 },
+};
+
+#define MOON_LR_TERMS (int)(sizeof(moon_lr_terms) / sizeof(moon_lr_terms[0]))
+#define MOON_B_TERMS  (int)(sizeof(moon_b_terms) / sizeof(moon_b_terms[0]))
+
+// Fundamental arguments in degrees for Julian centuries T since J2000
+typedef struct {
+    double Lp, D, M, Mp, F, E;
+} MoonArgs;
+
+static void moon_args(double T, MoonArgs *a) {
+    a->Lp = 218.3164477L + 481267.88123421L * T;
+    a->D  = 297.8501921L + 445267.1114034L * T;
+    a->M  = 357.5291092L + 35999.0502909L * T;
+    a->Mp = 134.9633964L + 477198.8675055L * T;
+    a->F  =  93.2720950L + 483202.0175233L * T;
+    a->E  = 1 - 0.002516L * T;   // eccentricity of the Earth's orbit
+}
+
+// ------------------------------------------------------------
+// HELPER: Geocentric right ascension, declination (radians) and
+// horizontal parallax (degrees) of the moon at Julian Day jd
+// ------------------------------------------------------------
+static void moon_position(double jd, double *ra, double *dec, double *parallax) {
+    double T = (jd - 2451545.0L) / 36525.0L;
+    MoonArgs a;
+    moon_args(T, &a);
+
+    double sum_l = 0, sum_r = 0, sum_b = 0;
+    for (int i = 0; i < MOON_LR_TERMS; i++) {
+        double arg = (moon_lr_terms[i].D * a.D + moon_lr_terms[i].M * a.M +
+                      moon_lr_terms[i].Mp * a.Mp + moon_lr_terms[i].F * a.F) * PI/180;
+        double e = (moon_lr_terms[i].M == 0) ? 1 : a.E;
+        sum_l += e * moon_lr_terms[i].l * sin(arg);
+        sum_r += e * moon_lr_terms[i].r * cos(arg);
+    }
+    for (int i = 0; i < MOON_B_TERMS; i++) {
+        double arg = (moon_b_terms[i].D * a.D + moon_b_terms[i].M * a.M +
+                      moon_b_terms[i].Mp * a.Mp + moon_b_terms[i].F * a.F) * PI/180;
+        double e = (moon_b_terms[i].M == 0) ? 1 : a.E;
+        sum_b += e * moon_b_terms[i].b * sin(arg);
+    }
+
+    double lambda = (a.Lp + sum_l / 1e6L) * PI/180;
+    double beta = (sum_b / 1e6L) * PI/180;
+    double distance = 385000.56L + sum_r / 1000;   // km
+    double eps = (23.4392911L - 0.0130042L * T) * PI/180;
+
+    *ra = atan2(sin(lambda) * cos(eps) - tan(beta) * sin(eps), cos(lambda));
+    *dec = asin(sin(beta) * cos(eps) + cos(beta) * sin(eps) * sin(lambda));
+    *parallax = asin(6378.14L / distance) * 180/PI;
+}
+
+// Context of moon_altitude(): observer and 0h UT of the date
+typedef struct {
+    double jd0;
+    double sin_lat, cos_lat;
+    double longitude_deg;
+} MoonObserver;
+
+// ------------------------------------------------------------
+// HELPER: Altitude of the moon's upper limb relative to the
+// rise/set altitude, in degrees. Parallax varies by a tenth of a
+// degree over the month, so it goes into the function rather than
+// into the threshold: moonrise is the crossing of 0.
+// ------------------------------------------------------------
+static double moon_altitude(double ut_hours, void *ctx) {
+    const MoonObserver *obs = ctx;
+    double jd = obs->jd0 + ut_hours / 24.0L;
+    double ra, dec, parallax;
+    moon_position(jd, &ra, &dec, &parallax);
+
+    double H = (greenwich_sidereal_deg(jd) + obs->longitude_deg) * PI/180 - ra;
+    double sin_alt = obs->sin_lat * sin(dec) + obs->cos_lat * cos(dec) * cos(H);
+
+    // Meeus 15: h0 = 0.7275 * parallax - 0.5667 (refraction, semidiameter)
+    return asin(sin_alt) * 180/PI - (0.7275L * parallax - 0.5667L);
+}
+
+// ------------------------------------------------------------
+// MAIN FUNCTION: moon()
+// ------------------------------------------------------------
+// At most HORIZON_SAMPLES + 2 * HORIZON_REFINE_STEPS evaluations of
+// the series per call, and no memory beyond one HorizonDay.
+//
+MoonTimes moon(int year, int month, int day,
+               double latitude_deg, double longitude_deg,
+               float time_zone_offset_to_utc_in_hours)
+{
+    MoonTimes result;
+    memset(&result, -1, sizeof(result));
+    if (!is_valid_date(year, month, day)) return result;
+
+    MoonObserver obs;
+    obs.jd0 = julian_day(year, month, day, 0);
+    obs.sin_lat = sin(latitude_deg * PI/180);
+    obs.cos_lat = cos(latitude_deg * PI/180);
+    obs.longitude_deg = longitude_deg;
+
+    HorizonDay samples;
+    horizon_day_init(&samples, moon_altitude, &obs, -time_zone_offset_to_utc_in_hours);
+    split_time(horizon_crossing(&samples, 0, 1), &result.moonrise_hour, &result.moonrise_minute);
+    split_time(horizon_crossing(&samples, 0, 0), &result.moonset_hour, &result.moonset_minute);
+
+    // Phase angle at local noon (Meeus 48.4), illuminated fraction
+    MoonArgs a;
+    moon_args((obs.jd0 + (12 - (double)time_zone_offset_to_utc_in_hours) / 24.0L - 2451545.0L) / 36525.0L, &a);
+    double D = fmod(a.D, 360);
+    if (D < 0) D += 360;
+    double i = 180 - D
+               - 6.289L * sin(a.Mp * PI/180)
+               + 2.100L * sin(a.M * PI/180)
+               - 1.274L * sin((2 * a.D - a.Mp) * PI/180)
+               - 0.658L * sin(2 * a.D * PI/180)
+               - 0.214L * sin(2 * a.Mp * PI/180)
+               - 0.110L * sin(a.D * PI/180);
+    result.illumination_percent = (int)round(50 * (1 + cos(i * PI/180)));
+
+    // Eight phases of 45 degrees of elongation, centred on new, quarter, full...
+    result.phase = (MoonPhase)((int)((D + 22.5L) / 45) % MoonPhaseCount);
+
+    return result;
+}
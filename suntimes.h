@@ -1,23 +1,265 @@
 #ifndef SUNTIMES_H
 #define SUNTIMES_H
 
+// ------------------------------------------------------------
+// ENUM: SunEvent
+// ------------------------------------------------------------
+// The eight horizon crossings computed by sun(), in the order in
+// which they happen during a normal day.
+//
+typedef enum {
+    SunEventAstronomicalDawn,
+    SunEventNauticalDawn,
+    SunEventCivilDawn,
+    SunEventSunrise,
+    SunEventSunset,
+    SunEventCivilDusk,
+    SunEventNauticalDusk,
+    SunEventAstronomicalDusk,
+    SunEventCount
+} SunEvent;
+
+// ------------------------------------------------------------
+// ENUM: SunEventStatus
+// ------------------------------------------------------------
+// Whether an event happens on a given day. Decided up front from
+// the altitude of the sun at local noon and midnight: an event at
+// altitude h exists only if midnight altitude < h < noon altitude.
+//
+typedef enum {
+    SunEventOccurs,
+    SunEventAlwaysAbove,  // sun never below the event's altitude
+    SunEventAlwaysBelow   // sun never above it
+} SunEventStatus;
+
+// ------------------------------------------------------------
+// STRUCT: SunTimes
+// ------------------------------------------------------------
+// Contains all relevant solar times for a specific date and location.
+// All times are expressed in hour + minute integer fields.
+//
+// Includes Civil, Nautical, and Astronomical dawn/dusk times,
+// plus sunrise, sunset, and day length.
+//
+// Events that do not happen (white nights, polar day or night)
+// have their times set to -1; 'status' says why, and 'comment'
+// contains the explanation. The day length is then 24:00 or 0:00.
+//
 typedef struct {
+    // Civil dawn/dusk (sun at -6 degrees)
     int civil_dawn_hour, civil_dawn_minute;
     int civil_dusk_hour, civil_dusk_minute;
+
+    // Nautical dawn/dusk (sun at -12 degrees)
     int nautical_dawn_hour, nautical_dawn_minute;
     int nautical_dusk_hour, nautical_dusk_minute;
+
+    // Astronomical dawn/dusk (sun at -18 degrees)
     int astronomical_dawn_hour, astronomical_dawn_minute;
     int astronomical_dusk_hour, astronomical_dusk_minute;
+
+    // Sunrise & sunset times
     int sunrise_hour, sunrise_minute;
     int sunset_hour, sunset_minute;
+
+    // Day length
     int daylength_hour, daylength_minute;
+
+    // Per event, indexed by SunEvent
+    SunEventStatus status[SunEventCount];
+
+    // Comment for errors or special conditions
     char comment[256];
+
 } SunTimes;
 
+// Marks a seed slot that holds no previous solution
+#define SUN_NO_SEED (-99.0L)
+
+// ------------------------------------------------------------
+// STRUCT: SunState
+// ------------------------------------------------------------
+// Warm-start state for stepping through dates at one location.
+// Holds the UT of every event from the previous call; since the
+// declination and the equation of time drift slowly, yesterday's
+// event time is an excellent first guess for today's and the
+// solver usually converges in a single pass.
+//
+// Reset it whenever the location changes.
+//
+typedef struct {
+    double seed_ut[SunEventCount];
+} SunState;
+
+// ------------------------------------------------------------
+// STRUCT: SunDayTerms
+// ------------------------------------------------------------
+// The date-dependent part of the sun engine, evaluated once for a
+// date and a representative UT, then shared by every location in a
+// batch. Single precision on purpose: the batch loop runs on the FPU.
+//
+typedef struct {
+    float sin_dec, cos_dec;   // Sun declination
+    float sidereal_offset;    // RA minus sidereal time term, hours
+    float ut_hours;           // UT the terms were evaluated for
+} SunDayTerms;
+
+// ------------------------------------------------------------
+// STRUCT: HorizonDay
+// ------------------------------------------------------------
+// Shared horizon-crossing machinery: the altitude of a body is
+// sampled at fixed steps across one local day, then each crossing
+// of a threshold is bracketed between two samples and refined with
+// at most HORIZON_REFINE_STEPS further evaluations. Cost and memory
+// per day are therefore fixed, however expensive the body's
+// ephemeris is.
+//
+#define HORIZON_SAMPLES 25        // hourly, 00:00..24:00 local time
+#define HORIZON_REFINE_STEPS 3
+
+typedef double (*AltitudeFn)(double ut_hours, void *ctx);
+
+typedef struct {
+    AltitudeFn altitude;
+    void *ctx;
+    double start_ut;               // UT of local midnight
+    double alt[HORIZON_SAMPLES];   // degrees
+} HorizonDay;
+
+// ------------------------------------------------------------
+// STRUCT: SunDay
+// ------------------------------------------------------------
+// Sun altitude samples of one local day at one location, for
+// crossings of arbitrary altitudes. Any number of angles can be
+// queried with sun_altitude_crossing() against the same samples;
+// each query only costs its refinement steps. 'samples' points
+// into 'observer', so a SunDay must not be copied after init.
+//
+typedef struct {
+    double day_number;             // day of year
+    double sin_lat, cos_lat;
+    double lng_hour;               // longitude in hours
+} SunObserver;
+
+typedef struct {
+    SunObserver observer;
+    HorizonDay samples;
+} SunDay;
+
+// Photography light, by sun altitude: golden hour from -4 to +6
+// degrees, blue hour from -8 to -4 degrees
+#define SUN_GOLDEN_HOUR_HIGH_DEG 6.0L
+#define SUN_BLUE_HOUR_HIGH_DEG (-4.0L)
+#define SUN_BLUE_HOUR_LOW_DEG (-8.0L)
+
+// ------------------------------------------------------------
+// STRUCT: SunLight
+// ------------------------------------------------------------
+// Start and end of the morning and evening golden and blue hours
+// in local hours, -1 where the sun does not cross the altitude.
+//
+typedef struct {
+    double start, end;
+} SunInterval;
+
+typedef struct {
+    SunInterval blue_morning, golden_morning;
+    SunInterval golden_evening, blue_evening;
+} SunLight;
+
+// ------------------------------------------------------------
+// ENUM: MoonPhase
+// ------------------------------------------------------------
+typedef enum {
+    MoonNew,
+    MoonWaxingCrescent,
+    MoonFirstQuarter,
+    MoonWaxingGibbous,
+    MoonFull,
+    MoonWaningGibbous,
+    MoonLastQuarter,
+    MoonWaningCrescent,
+    MoonPhaseCount
+} MoonPhase;
+
+// ------------------------------------------------------------
+// STRUCT: MoonTimes
+// ------------------------------------------------------------
+// Moonrise and moonset of one local day (-1 if the moon does not
+// rise or set on that day, which happens about once a month) and
+// the phase at local noon.
+//
+typedef struct {
+    int moonrise_hour, moonrise_minute;
+    int moonset_hour, moonset_minute;
+    int illumination_percent;
+    MoonPhase phase;
+} MoonTimes;
+
+// ------------------------------------------------------------
+// STRUCT: SunTracker
+// ------------------------------------------------------------
+// Live solar position. sun_tracker_sync() evaluates the ephemeris
+// once; within a day only the hour angle advances, so
+// sun_tracker_advance() just rotates (sin H, cos H) by a fixed
+// per-second angle with the angle-addition formulas. The caller
+// resyncs when advance() says so, which also corrects the slow
+// drift of declination and right ascension.
+//
+#define SUN_TRACKER_RESYNC_SECONDS 300
+
+typedef struct {
+    double sin_lat, cos_lat;
+    double sin_dec, cos_dec;
+    double sin_h, cos_h;          // local hour angle
+    double sin_step, cos_step;    // hour angle advance per second
+    int seconds_since_sync;
+} SunTracker;
+
 SunTimes sun(int year, int month, int day,
              int lat_degree, int lat_minute,
              int lon_degree, int lon_minute,
              int height_meters,
              float time_zone_offset_to_utc_in_hours);
 
+void sun_state_reset(SunState* state);
+
+SunTimes sun_step(SunState* state,
+                  int year, int month, int day,
+                  double latitude_deg, double longitude_deg,
+                  float time_zone_offset_to_utc_in_hours);
+
+void sun_day_terms(SunDayTerms* terms, int year, int month, int day, double ut_hours);
+
+void sun_batch_event(const SunDayTerms* terms, SunEvent event,
+                     const float* sin_lat, const float* cos_lat,
+                     const float* lng_hour, int count, float* event_ut);
+
+double julian_day(int year, int month, int day, double ut_hours);
+
+void horizon_day_init(HorizonDay *day, AltitudeFn altitude, void *ctx, double start_ut);
+
+double horizon_crossing(const HorizonDay *day, double threshold_deg, int rising);
+
+void sun_tracker_sync(SunTracker *tracker, int year, int month, int day, double ut_hours,
+                      double latitude_deg, double longitude_deg);
+
+int sun_tracker_advance(SunTracker *tracker, int seconds);
+
+void sun_tracker_position(const SunTracker *tracker, double *azimuth_deg, double *elevation_deg);
+
+void sun_day_init(SunDay *day, int year, int month, int day_of_month,
+                  double latitude_deg, double longitude_deg,
+                  float time_zone_offset_to_utc_in_hours);
+
+double sun_altitude_crossing(const SunDay *day, double altitude_deg, int rising);
+
+SunLight sun_light(int year, int month, int day,
+                   double latitude_deg, double longitude_deg,
+                   float time_zone_offset_to_utc_in_hours);
+
+MoonTimes moon(int year, int month, int day,
+               double latitude_deg, double longitude_deg,
+               float time_zone_offset_to_utc_in_hours);
+
 #endif
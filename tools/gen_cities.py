@@ -0,0 +1,79 @@
+#!/usr/bin/env python3
+"""Generate cities_builtin.c, the flash-resident city table, from the
+city list in data/european_cities.txt.
+
+Usage: gen_cities.py <european_cities.txt> <cities_builtin.c>
+
+The output is checked in and compiled like any other source file, so
+the app builds without Python; rerun this script after editing the
+data file.
+"""
+import csv
+import sys
+
+
+def c_string(text):
+    return '"' + text.replace('\\', '\\\\').replace('"', '\\"') + '"'
+
+
+def c_double(text):
+    value = float(text)
+    return repr(value) if value != int(value) else "%.1f" % value
+
+
+def read_cities(path):
+    cities = []
+    with open(path, encoding="utf-8", newline="") as f:
+        for row in csv.reader(f):
+            if not row or row[0].startswith("#"):
+                continue
+            # Country_Code,UTC_Shift,City_Name,Longitude,Latitude,Elevation_m,
+            # Population_2024,Founding_Date,Capital
+            cities.append({
+                "country_code": row[0].strip()[:2],
+                "utc_shift": c_double(row[1]),
+                "name": row[2].strip(),
+                "longitude": c_double(row[3]),
+                "latitude": c_double(row[4]),
+                "elevation_m": int(row[5] or 0),
+                "is_capital": 1 if row[8].strip().upper() == "Y" else 0,
+            })
+    # Stable sort: file order is kept within a country
+    cities.sort(key=lambda c: c["country_code"])
+    return cities
+
+
+def write_table(cities, source, path):
+    ranges = []
+    for i, city in enumerate(cities):
+        if ranges and ranges[-1][0] == city["country_code"]:
+            ranges[-1][2] += 1
+        else:
+            ranges.append([city["country_code"], i, 1])
+
+    with open(path, "w", encoding="utf-8", newline="\n") as out:
+        out.write("// Generated by tools/gen_cities.py from %s. Do not edit.\n" % source)
+        out.write('#include "cities.h"\n\n')
+        out.write("const City builtin_cities[] = {\n")
+        for c in cities:
+            out.write('    { "%s", %s, %s, %s, %s, %d, %d },\n' % (
+                c["country_code"], c["utc_shift"], c_string(c["name"]),
+                c["longitude"], c["latitude"], c["elevation_m"], c["is_capital"]))
+        out.write("};\n\n")
+        out.write("const int builtin_city_count = %d;\n\n" % len(cities))
+        out.write("const CityRange builtin_city_ranges[] = {\n")
+        for code, first, count in ranges:
+            out.write('    { "%s", %d, %d },\n' % (code, first, count))
+        out.write("};\n\n")
+        out.write("const int builtin_city_range_count = %d;\n" % len(ranges))
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    source = sys.argv[1]
+    write_table(read_cities(source), source.replace("\\", "/").split("/")[-1], sys.argv[2])
+
+
+if __name__ == "__main__":
+    main()
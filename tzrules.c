@@ -0,0 +1,162 @@
+#include "tzrules.h"
+#include <datetime/datetime.h>
+#include <string.h>
+
+// ------------------------------------------------------------
+// Rule table. Transition times follow the current legislation
+// (as of 2025); historic rules are not covered.
+// ------------------------------------------------------------
+enum {
+    TzRuleNone,
+    TzRuleEU,
+    TzRuleMD,
+    TzRuleUS,
+    TzRuleCU,
+    TzRuleEG,
+    TzRuleCL,
+    TzRuleNZ,
+};
+
+static const TzRule tz_rules[] = {
+    [TzRuleNone] = { "none", 0,  { 0 },                              { 0 } },
+    // Last Sunday of March/October, 01:00 UTC: all of Europe switches at once
+    [TzRuleEU]   = { "EU",   60, { 3,  5, 0, TzTimeUtc,      60 },   { 10, 5, 0, TzTimeUtc,      60 } },
+    [TzRuleMD]   = { "MD",   60, { 3,  5, 0, TzTimeStandard, 120 },  { 10, 5, 0, TzTimeWall,     180 } },
+    // Second Sunday of March to first Sunday of November, 02:00 local
+    [TzRuleUS]   = { "US",   60, { 3,  2, 0, TzTimeWall,     120 },  { 11, 1, 0, TzTimeWall,     120 } },
+    [TzRuleCU]   = { "CU",   60, { 3,  2, 0, TzTimeWall,     0 },    { 11, 1, 0, TzTimeWall,     60 } },
+    // Last Friday of April to the end of the last Thursday of October
+    [TzRuleEG]   = { "EG",   60, { 4,  5, 5, TzTimeWall,     0 },    { 10, 5, 4, TzTimeWall,     1440 } },
+    // Southern hemisphere. Chile: first Sunday on or after the 2nd of
+    // September/April, i.e. midnight of the Saturday before, local time
+    [TzRuleCL]   = { "CL",   60, { 9,  1, 0, TzTimeUtc,      240, 2 }, { 4,  1, 0, TzTimeUtc,      180, 2 } },
+    [TzRuleNZ]   = { "NZ",   60, { 9,  5, 0, TzTimeStandard, 120 },  { 4,  1, 0, TzTimeStandard, 120 } },
+};
+
+// ------------------------------------------------------------
+// Zone table: country code to rule. Countries not listed observe
+// no DST; neither do those whose DST differs by region (e.g. AU),
+// since the city list has no region field.
+// ------------------------------------------------------------
+static const struct {
+    char country[3];
+    uint8_t rule;
+} tz_zones[] = {
+    // Europe
+    { "AD", TzRuleEU }, { "AL", TzRuleEU }, { "AT", TzRuleEU }, { "BA", TzRuleEU },
+    { "BE", TzRuleEU }, { "BG", TzRuleEU }, { "CH", TzRuleEU }, { "CY", TzRuleEU },
+    { "CZ", TzRuleEU }, { "DE", TzRuleEU }, { "DK", TzRuleEU }, { "EE", TzRuleEU },
+    { "ES", TzRuleEU }, { "FI", TzRuleEU }, { "FR", TzRuleEU }, { "GB", TzRuleEU },
+    { "GR", TzRuleEU }, { "HR", TzRuleEU }, { "HU", TzRuleEU }, { "IE", TzRuleEU },
+    { "IT", TzRuleEU }, { "LI", TzRuleEU }, { "LT", TzRuleEU }, { "LU", TzRuleEU },
+    { "LV", TzRuleEU }, { "MC", TzRuleEU }, { "ME", TzRuleEU }, { "MK", TzRuleEU },
+    { "MT", TzRuleEU }, { "NL", TzRuleEU }, { "NO", TzRuleEU }, { "PL", TzRuleEU },
+    { "PT", TzRuleEU }, { "RO", TzRuleEU }, { "RS", TzRuleEU }, { "SE", TzRuleEU },
+    { "SI", TzRuleEU }, { "SK", TzRuleEU }, { "SM", TzRuleEU }, { "UA", TzRuleEU },
+    { "VA", TzRuleEU }, { "GL", TzRuleEU },
+    { "MD", TzRuleMD },
+    // Americas
+    { "US", TzRuleUS }, { "CA", TzRuleUS },
+    { "CU", TzRuleCU },
+    { "CL", TzRuleCL },
+    // Africa, Oceania
+    { "EG", TzRuleEG },
+    { "NZ", TzRuleNZ },
+};
+
+static const int16_t days_before_month[13] = {
+    0, 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334
+};
+
+// ------------------------------------------------------------
+// HELPER: Weekday (0 = Sunday), Gregorian calendar
+// ------------------------------------------------------------
+static int tz_weekday(int y, int m, int d) {
+    static const int t[] = { 0, 3, 2, 5, 0, 3, 5, 1, 4, 6, 2, 4 };
+    if (m < 3) y -= 1;
+    return (y + y / 4 - y / 100 + y / 400 + t[m - 1] + d) % 7;
+}
+
+// ------------------------------------------------------------
+// tz_minute_of_year(): minutes from January 1st, 00:00 to the
+// start of the given day
+// ------------------------------------------------------------
+int tz_minute_of_year(int year, int month, int day) {
+    int doy = days_before_month[month] + day - 1;
+    if (month > 2 && datetime_is_leap_year(year)) doy++;
+    return doy * 1440;
+}
+
+// ------------------------------------------------------------
+// tz_noon_offset_minutes(): offset to UTC in effect at noon,
+// local standard time, of a day of tz->year. Transitions happen
+// at night, so this is the offset of the whole day.
+// ------------------------------------------------------------
+int tz_noon_offset_minutes(const TzYear *tz, int month, int day) {
+    return tz_offset_minutes(tz, tz_minute_of_year(tz->year, month, day) + 720 - tz->std_minutes);
+}
+
+// ------------------------------------------------------------
+// tz_rule_for(): look up the rule of a country
+// ------------------------------------------------------------
+const TzRule *tz_rule_for(const char *country_code) {
+    for (unsigned i = 0; i < sizeof(tz_zones) / sizeof(tz_zones[0]); i++) {
+        if (strcmp(tz_zones[i].country, country_code) == 0)
+            return &tz_rules[tz_zones[i].rule];
+    }
+    return &tz_rules[TzRuleNone];
+}
+
+// ------------------------------------------------------------
+// HELPER: Resolve a transition to minutes of the year in UTC.
+// 'offset_before' is the local offset in effect before it.
+// ------------------------------------------------------------
+static int32_t tz_transition_utc(const TzTransition *tr, int year,
+                                 int std_minutes, int offset_before) {
+    int day;
+    if (tr->week == 5) {
+        // Last weekday: step back from the last day of the month
+        int last = (tr->month == 12) ? 31
+                 : (days_before_month[tr->month + 1] - days_before_month[tr->month]
+                    + (tr->month == 2 && datetime_is_leap_year(year)));
+        day = last - (tz_weekday(year, tr->month, last) - tr->weekday + 7) % 7;
+    } else {
+        int from = tr->from_day ? tr->from_day : 1;
+        int first = tz_weekday(year, tr->month, from);
+        day = from + (tr->weekday - first + 7) % 7 + 7 * (tr->week - 1);
+    }
+
+    int32_t minute = tz_minute_of_year(year, tr->month, day) + tr->minute;
+    switch (tr->time_base) {
+        case TzTimeStandard: return minute - std_minutes;
+        case TzTimeWall:     return minute - offset_before;
+        default:             return minute;
+    }
+}
+
+// ------------------------------------------------------------
+// tz_year_init(): precompute the transitions of one year, so
+// that tz_offset_minutes() needs no calendar arithmetic at all
+// ------------------------------------------------------------
+void tz_year_init(TzYear *tz, const TzRule *rule, int year, int std_minutes) {
+    tz->year = year;
+    tz->std_minutes = std_minutes;
+    tz->save_minutes = rule->save_minutes;
+    tz->invert = 0;
+    tz->lo = 0;
+    tz->span = 0;
+    if (rule->save_minutes == 0) return;
+
+    int32_t start = tz_transition_utc(&rule->start, year, std_minutes, std_minutes);
+    int32_t end = tz_transition_utc(&rule->end, year, std_minutes,
+                                    std_minutes + rule->save_minutes);
+    if (start < end) {
+        tz->lo = start;
+        tz->span = end - start;
+    } else {
+        // Southern hemisphere: standard time between end and start
+        tz->lo = end;
+        tz->span = start - end;
+        tz->invert = 1;
+    }
+}
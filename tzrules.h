@@ -0,0 +1,80 @@
+#ifndef TZRULES_H
+#define TZRULES_H
+
+#include <stdint.h>
+
+// ------------------------------------------------------------
+// ENUM: TzTimeBase
+// ------------------------------------------------------------
+// Clock in which the time of a transition is given.
+//
+typedef enum {
+    TzTimeUtc,       // e.g. EU: 01:00 UTC
+    TzTimeStandard,  // local standard time
+    TzTimeWall       // local time in effect just before the switch
+} TzTimeBase;
+
+// ------------------------------------------------------------
+// STRUCT: TzTransition
+// ------------------------------------------------------------
+// "The n-th (or last) weekday of a month at a given time", the
+// general form of all daylight saving time rules in use today.
+// Rules like "first Sunday on or after the 2nd" count the weeks
+// from 'from_day' instead of the 1st.
+//
+typedef struct {
+    uint8_t month;      // 1..12
+    uint8_t week;       // 1..4 = n-th weekday of the month, 5 = last
+    uint8_t weekday;    // 0 = Sunday .. 6 = Saturday
+    uint8_t time_base;  // TzTimeBase of 'minute'
+    int16_t minute;     // minutes after midnight, up to 1440
+    uint8_t from_day;   // first day counted for 'week' 1..4, 0 = the 1st
+} TzTransition;
+
+// ------------------------------------------------------------
+// STRUCT: TzRule
+// ------------------------------------------------------------
+// Daylight saving time rule of a zone. 'save_minutes' is 0 for
+// zones without DST. In the southern hemisphere 'start' lies
+// later in the year than 'end'.
+//
+typedef struct {
+    const char *name;
+    int16_t save_minutes;
+    TzTransition start, end;
+} TzRule;
+
+// ------------------------------------------------------------
+// STRUCT: TzYear
+// ------------------------------------------------------------
+// A rule resolved for one year and one standard offset. Instants
+// are minutes since January 1st, 00:00 UTC of 'year'. The DST
+// interval is stored as start + span so that the lookup is a
+// single unsigned comparison for both hemispheres.
+//
+typedef struct {
+    int16_t year;
+    int16_t std_minutes;   // standard offset to UTC
+    int16_t save_minutes;  // added while DST is in effect
+    uint8_t invert;        // 1: DST outside the interval (southern hemisphere)
+    int32_t lo;            // start of the interval
+    uint32_t span;         // length of the interval, 0 if no DST
+} TzYear;
+
+const TzRule *tz_rule_for(const char *country_code);
+
+void tz_year_init(TzYear *tz, const TzRule *rule, int year, int std_minutes);
+
+int tz_minute_of_year(int year, int month, int day);
+
+int tz_noon_offset_minutes(const TzYear *tz, int month, int day);
+
+// ------------------------------------------------------------
+// tz_offset_minutes(): offset to UTC at an instant of the year
+// ------------------------------------------------------------
+static inline int tz_offset_minutes(const TzYear *tz, int32_t utc_minute_of_year) {
+    int in_interval = (uint32_t)(utc_minute_of_year - tz->lo) < tz->span;
+    return tz->std_minutes + ((in_interval ^ tz->invert) ? tz->save_minutes : 0);
+}
+
+#endif